@@ -1,6 +1,7 @@
 function(add_spmdfy_source ISPC_SOURCE_TARGET SPMDFY_CUDA_SOURCE SPMDFY_ISPC_SOURCE)
-    set(oneValueArgs HINTS ISPC_DIR)
+    set(oneValueArgs HINTS ISPC_DIR CACHE_DIR PCH_DIR)
     set(options VEROBSE DUMP_JSON)
+    set(multiValueArgs OPTIONS)
 
     cmake_parse_arguments(SPMDFY "${options}" "${oneValueArgs}" "${multiValueArgs}" ${ARGN})
     set(SPMDFY_EXE ${SPMDFY_HINTS}/spmdfy)
@@ -15,15 +16,42 @@ function(add_spmdfy_source ISPC_SOURCE_TARGET SPMDFY_CUDA_SOURCE SPMDFY_ISPC_SOU
         set(${SPMDFY_ISPC_SOURCE}_DIR ${CMAKE_CURRENT_BINARY_DIR})
     endif()
 
+    if(SPMDFY_CACHE_DIR)
+        set(${SPMDFY_ISPC_SOURCE}_CACHE_DIR ${SPMDFY_CACHE_DIR})
+    else()
+        set(${SPMDFY_ISPC_SOURCE}_CACHE_DIR ${CMAKE_BINARY_DIR}/spmdfy_cache)
+    endif()
+
+    if(SPMDFY_PCH_DIR)
+        set(${SPMDFY_ISPC_SOURCE}_PCH_DIR ${SPMDFY_PCH_DIR})
+    else()
+        set(${SPMDFY_ISPC_SOURCE}_PCH_DIR ${CMAKE_BINARY_DIR}/spmdfy_pch)
+    endif()
+
+    set(${SPMDFY_ISPC_SOURCE}_OUTPUT ${${SPMDFY_ISPC_SOURCE}_DIR}/${SPMDFY_ISPC_SOURCE})
+
+    # DEPFILE is supported by Ninja from CMake 3.7 and by Makefiles from 3.20,
+    # the headers included by the CUDA source are picked up from it
+    if((CMAKE_GENERATOR MATCHES "Ninja" AND NOT CMAKE_VERSION VERSION_LESS 3.7)
+       OR NOT CMAKE_VERSION VERSION_LESS 3.20)
+        set(${SPMDFY_ISPC_SOURCE}_MD -MD)
+        set(${SPMDFY_ISPC_SOURCE}_DEPFILE DEPFILE ${${SPMDFY_ISPC_SOURCE}_OUTPUT}.d)
+    endif()
+
     add_custom_command(
-        OUTPUT ${${SPMDFY_ISPC_SOURCE}_DIR}/${SPMDFY_ISPC_SOURCE}
-        COMMAND ${SPMDFY_EXE} -o ${${SPMDFY_ISPC_SOURCE}_DIR}/${SPMDFY_ISPC_SOURCE} 
+        OUTPUT ${${SPMDFY_ISPC_SOURCE}_OUTPUT}
+        COMMAND ${SPMDFY_EXE} -o ${${SPMDFY_ISPC_SOURCE}_OUTPUT}
+                              --cache-dir=${${SPMDFY_ISPC_SOURCE}_CACHE_DIR}
+                              --pch-cache=${${SPMDFY_ISPC_SOURCE}_PCH_DIR}
                               ${${SPMDFY_ISPC_SOURCE}_VERBOSE} 
+                              ${SPMDFY_OPTIONS}
                               ${CMAKE_CURRENT_SOURCE_DIR}/${SPMDFY_CUDA_SOURCE}
+                              ${${SPMDFY_ISPC_SOURCE}_MD}
         DEPENDS ${CMAKE_CURRENT_SOURCE_DIR}/${SPMDFY_CUDA_SOURCE} spmdfy
         WORKING_DIRECTORY ${CMAKE_CURRENT_BINARY_DIR}
         COMMENT "Building ISPC source"
         VERBATIM
+        ${${SPMDFY_ISPC_SOURCE}_DEPFILE}
     )
     add_custom_target(${ISPC_SOURCE_TARGET} DEPENDS ${${SPMDFY_ISPC_SOURCE}_DIR}/${SPMDFY_ISPC_SOURCE})
 endfunction()
\ No newline at end of file
@@ -0,0 +1,11 @@
+#include "affine_index.cuh"
+
+// the base of the coalesced accesses is a local computed before the barrier,
+// the accesses after it read the base from its initializer
+__global__ void affineIndex(const int *in, int *out) {
+    int row = blockIdx.x;
+    int off = row * blockDim.x;
+    out[off + threadIdx.x] = in[off + threadIdx.x] * 2;
+    __syncthreads();
+    out[off + threadIdx.x] += in[off + threadIdx.x];
+}
@@ -0,0 +1,3 @@
+#include <cuda_runtime.h>
+
+__global__ void affineIndex(const int *in, int *out);
@@ -0,0 +1,42 @@
+#include <iostream>
+#include <vector>
+
+#include "affine_index.cuh"
+#include "affine_index.h"
+#include "cuda_utils.cuh"
+
+void executeCUDA(const std::vector<int> &in, std::vector<int> &out,
+                 int nblocks, int nthreads) {
+    int *d_in = nullptr, *d_out = nullptr;
+    size_t bytes = in.size() * sizeof(int);
+    CUDACheck(cudaMalloc(&d_in, bytes));
+    CUDACheck(cudaMalloc(&d_out, bytes));
+    CUDACheck(cudaMemcpy(d_in, in.data(), bytes, cudaMemcpyHostToDevice));
+    affineIndex<<<nblocks, nthreads>>>(d_in, d_out);
+    CUDACheck(cudaMemcpy(out.data(), d_out, bytes, cudaMemcpyDeviceToHost));
+    cudaFree(d_in);
+    cudaFree(d_out);
+}
+
+void executeISPC(const std::vector<int> &in, std::vector<int> &out,
+                 int nblocks, int nthreads) {
+    ispc::Dim3 grid_dim{nblocks, 1, 1};
+    ispc::Dim3 block_dim{nthreads, 1, 1};
+    ispc::affineIndex(grid_dim, block_dim, 0, in.data(), out.data());
+}
+
+int main(void) {
+    const int nblocks = 16;
+    const int nthreads = 64;
+    const int n = nblocks * nthreads;
+    std::vector<int> in(n), ref(n), cuda(n), ispc(n);
+    for (int i = 0; i < n; i++) {
+        in[i] = i;
+        ref[i] = i * 3;
+    }
+    executeCUDA(in, cuda, nblocks, nthreads);
+    executeISPC(in, ispc, nblocks, nthreads);
+    if (checkResults(n, ref, cuda, ispc))
+        return 1;
+    return 0;
+}
@@ -0,0 +1,23 @@
+#include "barrier.cuh"
+
+// the barrier orders the store to global memory before the load of another
+// thread of the block, it must not be eliminated
+__global__ void globalReverse(int *d, int n) {
+    int t = threadIdx.x + blockIdx.x * blockDim.x;
+    int tr = blockIdx.x * blockDim.x + blockDim.x - threadIdx.x - 1;
+    int v = d[t] * 2;
+    d[t] = v;
+    __syncthreads();
+    d[n + t] = d[tr];
+}
+
+__device__ int load(const int *p, int i) { return p[i]; }
+
+// the load is hidden in a helper, the call is a memory access
+__global__ void helperReverse(int *d, int n) {
+    int t = threadIdx.x + blockIdx.x * blockDim.x;
+    int tr = blockIdx.x * blockDim.x + blockDim.x - threadIdx.x - 1;
+    d[t] = d[t] * 2;
+    __syncthreads();
+    d[n + t] = load(d, tr);
+}
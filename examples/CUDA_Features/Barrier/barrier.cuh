@@ -0,0 +1,5 @@
+#include <cuda_runtime.h>
+
+__global__ void globalReverse(int *d, int n);
+
+__global__ void helperReverse(int *d, int n);
@@ -0,0 +1,62 @@
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "barrier.cuh"
+#include "barrier.h"
+#include "cuda_utils.cuh"
+
+void executeReference(const std::vector<int> &a, std::vector<int> &r, int n,
+                      int nthreads) {
+    for (int t = 0; t < n; t++) {
+        int block = t / nthreads;
+        int tr = block * nthreads + nthreads - t % nthreads - 1;
+        r[t] = a[t] * 2;
+        r[n + t] = a[tr] * 2;
+    }
+}
+
+void executeCUDA(const std::vector<int> &a, std::vector<int> &d, int n,
+                 int nthreads, bool helper) {
+    int *d_d = nullptr;
+    CUDACheck(cudaMalloc(&d_d, 2 * n * sizeof(int)));
+    CUDACheck(cudaMemcpy(d_d, a.data(), 2 * n * sizeof(int),
+                         cudaMemcpyHostToDevice));
+    if (helper) {
+        helperReverse<<<n / nthreads, nthreads>>>(d_d, n);
+    } else {
+        globalReverse<<<n / nthreads, nthreads>>>(d_d, n);
+    }
+    CUDACheck(cudaMemcpy(d.data(), d_d, 2 * n * sizeof(int),
+                         cudaMemcpyDeviceToHost));
+    cudaFree(d_d);
+}
+
+void executeISPC(const std::vector<int> &a, std::vector<int> &d, int n,
+                 int nthreads, bool helper) {
+    ispc::Dim3 grid_dim{n / nthreads, 1, 1};
+    ispc::Dim3 block_dim{nthreads, 1, 1};
+    std::memcpy(d.data(), a.data(), 2 * n * sizeof(int));
+    if (helper) {
+        ispc::helperReverse(grid_dim, block_dim, 0, d.data(), n);
+    } else {
+        ispc::globalReverse(grid_dim, block_dim, 0, d.data(), n);
+    }
+}
+
+int main(void) {
+    const int n = 256;
+    const int nthreads = 64;
+    std::vector<int> a(2 * n), r(2 * n), cuda(2 * n), ispc(2 * n);
+    for (int i = 0; i < 2 * n; i++) {
+        a[i] = i;
+    }
+    executeReference(a, r, n, nthreads);
+    for (bool helper : {false, true}) {
+        executeCUDA(a, cuda, n, nthreads, helper);
+        executeISPC(a, ispc, n, nthreads, helper);
+        if (checkResults(2 * n, r, cuda, ispc))
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,9 @@
+#include "group_atomic.cuh"
+
+// transpiled with -fgroup-atomics, the index of the statement atomic reads
+// the coalesced d_in[myId] and the atomic under the cast stays a plain one
+__global__ void groupAtomic(int *d_bins, const int *d_in, const int BIN_COUNT) {
+    int myId = threadIdx.x + blockDim.x * blockIdx.x;
+    atomicAdd(&d_bins[d_in[myId] % BIN_COUNT], 1);
+    (void)atomicAdd(&d_bins[(d_in[myId] + 1) % BIN_COUNT], 2);
+}
@@ -0,0 +1,3 @@
+#include <cuda_runtime.h>
+
+__global__ void groupAtomic(int *d_bins, const int *d_in, const int BIN_COUNT);
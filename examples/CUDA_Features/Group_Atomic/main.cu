@@ -0,0 +1,55 @@
+#include <iostream>
+#include <vector>
+
+#include "cuda_utils.cuh"
+#include "group_atomic.cuh"
+#include "group_atomic.h"
+
+void executeReference(const std::vector<int> &in, std::vector<int> &bins,
+                      int BIN_COUNT) {
+    for (int item : in) {
+        bins[item % BIN_COUNT] += 1;
+        bins[(item + 1) % BIN_COUNT] += 2;
+    }
+}
+
+void executeCUDA(const std::vector<int> &in, std::vector<int> &bins,
+                 int BIN_COUNT, int nthreads) {
+    int *d_in = nullptr, *d_bins = nullptr;
+    CUDACheck(cudaMalloc(&d_in, in.size() * sizeof(int)));
+    CUDACheck(cudaMalloc(&d_bins, BIN_COUNT * sizeof(int)));
+    CUDACheck(cudaMemcpy(d_in, in.data(), in.size() * sizeof(int),
+                         cudaMemcpyHostToDevice));
+    CUDACheck(cudaMemset(d_bins, 0, BIN_COUNT * sizeof(int)));
+    groupAtomic<<<in.size() / nthreads, nthreads>>>(d_bins, d_in, BIN_COUNT);
+    CUDACheck(cudaMemcpy(bins.data(), d_bins, BIN_COUNT * sizeof(int),
+                         cudaMemcpyDeviceToHost));
+    cudaFree(d_in);
+    cudaFree(d_bins);
+}
+
+void executeISPC(const std::vector<int> &in, std::vector<int> &bins,
+                 int BIN_COUNT, int nthreads) {
+    ispc::Dim3 grid_dim{static_cast<int32_t>(in.size() / nthreads), 1, 1};
+    ispc::Dim3 block_dim{nthreads, 1, 1};
+    ispc::groupAtomic(grid_dim, block_dim, 0, bins.data(), in.data(),
+                      BIN_COUNT);
+}
+
+int main(void) {
+    const int ARRAY_SIZE = 1 << 14;
+    const int BIN_COUNT = 16;
+    const int nthreads = 128;
+    std::vector<int> in(ARRAY_SIZE), ref(BIN_COUNT), cuda(BIN_COUNT),
+        ispc(BIN_COUNT);
+    // few distinct bins per gang, the atomics of a gang are grouped
+    for (int i = 0; i < ARRAY_SIZE; i++) {
+        in[i] = (i / 4) * 7;
+    }
+    executeReference(in, ref, BIN_COUNT);
+    executeCUDA(in, cuda, BIN_COUNT, nthreads);
+    executeISPC(in, ispc, BIN_COUNT, nthreads);
+    if (checkResults(BIN_COUNT, ref, cuda, ispc))
+        return 1;
+    return 0;
+}
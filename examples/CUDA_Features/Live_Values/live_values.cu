@@ -0,0 +1,19 @@
+#include "live_values.cuh"
+
+// v and w are private to the thread and live across the barriers, the block
+// reads them back after its other threads ran
+__global__ void liveValues(const int *in, int *out, int n) {
+    extern __shared__ int s[];
+    int t = threadIdx.x;
+    int gid = blockIdx.x * blockDim.x + t;
+    int v = in[gid] * 3;
+    s[t] = v;
+    __syncthreads();
+    int w = s[blockDim.x - t - 1];
+    __syncthreads();
+    s[t] = v + w;
+    __syncthreads();
+    if (gid >= n)
+        return;
+    out[gid] = s[t] * v - w;
+}
@@ -0,0 +1,55 @@
+#include <iostream>
+#include <vector>
+
+#include "cuda_utils.cuh"
+#include "live_values.cuh"
+#include "live_values.h"
+
+void executeReference(const std::vector<int> &in, std::vector<int> &out,
+                      int n, int nthreads) {
+    for (int gid = 0; gid < n; gid++) {
+        int base = gid / nthreads * nthreads;
+        int v = in[gid] * 3;
+        int w = in[base + nthreads - gid % nthreads - 1] * 3;
+        out[gid] = (v + w) * v - w;
+    }
+}
+
+void executeCUDA(const std::vector<int> &in, std::vector<int> &out, int n,
+                 int nblocks, int nthreads) {
+    int *d_in = nullptr, *d_out = nullptr;
+    CUDACheck(cudaMalloc(&d_in, in.size() * sizeof(int)));
+    CUDACheck(cudaMalloc(&d_out, n * sizeof(int)));
+    CUDACheck(cudaMemcpy(d_in, in.data(), in.size() * sizeof(int),
+                         cudaMemcpyHostToDevice));
+    liveValues<<<nblocks, nthreads, nthreads * sizeof(int)>>>(d_in, d_out, n);
+    CUDACheck(cudaMemcpy(out.data(), d_out, n * sizeof(int),
+                         cudaMemcpyDeviceToHost));
+    cudaFree(d_in);
+    cudaFree(d_out);
+}
+
+void executeISPC(const std::vector<int> &in, std::vector<int> &out, int n,
+                 int nblocks, int nthreads) {
+    ispc::Dim3 grid_dim{nblocks, 1, 1};
+    ispc::Dim3 block_dim{nthreads, 1, 1};
+    ispc::liveValues(grid_dim, block_dim, nthreads * sizeof(int), in.data(),
+                     out.data(), n);
+}
+
+int main(void) {
+    // the last block is partial, its threads past n return early
+    const int n = 200;
+    const int nthreads = 64;
+    const int nblocks = (n - 1) / nthreads + 1;
+    std::vector<int> in(nblocks * nthreads), ref(n), cuda(n), ispc(n);
+    for (int i = 0; i < nblocks * nthreads; i++) {
+        in[i] = i;
+    }
+    executeReference(in, ref, n, nthreads);
+    executeCUDA(in, cuda, n, nblocks, nthreads);
+    executeISPC(in, ispc, n, nblocks, nthreads);
+    if (checkResults(n, ref, cuda, ispc))
+        return 1;
+    return 0;
+}
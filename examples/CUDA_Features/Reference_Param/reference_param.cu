@@ -0,0 +1,11 @@
+#include "reference_param.cuh"
+
+__device__ void advance(int &i, int step) { i += step; }
+
+// i starts uniform across the block, the helper makes it vary per thread
+// through the reference
+__global__ void referenceParam(const int *in, int *out) {
+    int i = blockIdx.x * blockDim.x;
+    advance(i, threadIdx.x);
+    out[i] = in[i] + i;
+}
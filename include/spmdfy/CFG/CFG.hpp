@@ -11,6 +11,7 @@
 #define SPMDFY_CFG_HPP
 
 #include <clang/AST/RecursiveASTVisitor.h>
+#include <llvm/Support/Allocator.h>
 
 #include <spmdfy/Logger.hpp>
 #include <spmdfy/utils.hpp>
@@ -20,6 +21,7 @@
 #include <memory>
 #include <tuple>
 #include <variant>
+#include <vector>
 
 namespace spmdfy {
 
@@ -33,6 +35,18 @@ class CFGNode;
 class BiDirectNode;
 class ExitNode;
 
+/// \return name of the kernel in ISPC, a specialization of a kernel template
+/// has its template arguments appended, e.g. reduce<256, float> is
+/// reduce_256_float and k<-1> is k_n1
+auto getKernelName(const clang::FunctionDecl *) -> std::string;
+
+/// \return true if the struct is named by --soa or annotated with spmdfy_soa
+auto isSoAMarked(const clang::RecordDecl *) -> bool;
+
+/// \return true if the arrays of the struct are laid out as ISPC soa<> arrays,
+/// which hold scalar fields only
+auto isSoARecord(const clang::RecordDecl *) -> bool;
+
 /**
  * \class CFGEdge
  * \ingroup CFG
@@ -78,8 +92,8 @@ class CFGEdge {
     auto setEdgeType(Edge edge_type) -> Edge;
 
   private:
-    Edge m_edge;
-    CFGNode *m_terminal;
+    Edge m_edge = Partial;
+    CFGNode *m_terminal = nullptr;
 };
 
 // :CFGEdge
@@ -97,24 +111,30 @@ class CFGNode {
   public:
     virtual ~CFGNode() {}
     /// \enum Node enum class
+    /// The kinds of a subclass are contiguous, classof of each class checks a
+    /// range of the enum(as in LLVM's RTTI). Keep the order when adding kinds
     enum Node {
-        Forward,
-        Backward,
-        BiDirect,
         GlobalVar,
         StructDecl,
+        Forward,
         KernelFunc,
         DeviceFunc,
+        BiDirect,
         Conditional,
         IfStmt,
         ForStmt,
+        LastConditional = ForStmt,
         Reconv,
         Internal,
-        Exit,
         ISPCBlock,
         ISPCBlockExit,
         ISPCGrid,
-        ISPCGridExit
+        ISPCGridExit,
+        LastBiDirect = ISPCGridExit,
+        LastForward = ISPCGridExit,
+        Backward,
+        Exit,
+        LastBackward = Exit
     };
 
     /// \enum Enumeration representing the position of the node in CFG
@@ -123,7 +143,7 @@ class CFGNode {
     /**
      * \return returns the node type
      */
-    auto getNodeType() -> Node const { return m_node_type; }
+    auto getNodeType() const -> Node { return m_node_type; }
 
     /**
      * \return returns context type
@@ -154,7 +174,7 @@ class CFGNode {
      * \return returns the source of the node in the AST or the name of the node
      * if it is not part of the AST
      */
-    virtual auto getSource() -> std::string const;
+    virtual auto getSource() -> llvm::StringRef const;
 
     /**
      * \return sets the source of the node
@@ -242,6 +262,10 @@ class GlobalVarNode : public CFGNode {
         return m_var_decl->getDeclKindName();
     }
 
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() == GlobalVar;
+    }
+
   private:
     const clang::VarDecl *m_var_decl;
 
@@ -259,11 +283,16 @@ class GlobalVarNode : public CFGNode {
  * Has only one edge that points forward in the CFG.
  *
  * */
-class ForwardNode : public virtual CFGNode {
+class ForwardNode : public CFGNode {
   public:
-    virtual ~ForwardNode() { delete m_next; }
+    virtual ~ForwardNode() = default;
     ForwardNode();
 
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() >= Forward &&
+               node->getNodeType() <= LastForward;
+    }
+
     /**
      * \return returns the next CFGNode in the control flow
      */
@@ -292,7 +321,7 @@ class ForwardNode : public virtual CFGNode {
     auto splitEdge(BiDirectNode *) -> BiDirectNode * override;
 
   protected:
-    CFGEdge *m_next;
+    CFGEdge m_next;
 };
 
 // :ForwardNode
@@ -305,26 +334,31 @@ class ForwardNode : public virtual CFGNode {
  * Has only one edge that points backward in the CFG.
  *
  * */
-class BackwardNode : public virtual CFGNode {
+class BackwardNode : public CFGNode {
   public:
     virtual ~BackwardNode() = default;
     BackwardNode();
+
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() >= Backward &&
+               node->getNodeType() <= LastBackward;
+    }
+
     /**
      * \return returns the previous node
      */
-    virtual auto getPrevious() -> CFGNode *const;
+    auto getPrevious() -> CFGNode *const override;
 
     /**
      * \param node - node to be set
      * \param edge_type - type of the edge(default = Complete)
      * \return sets the previous node
      */
-    virtual auto setPrevious(CFGNode *node,
-                             CFGEdge::Edge edge_type = CFGEdge::Complete)
-        -> CFGNode *;
+    auto setPrevious(CFGNode *node, CFGEdge::Edge edge_type = CFGEdge::Complete)
+        -> CFGNode * override;
 
   protected:
-    CFGEdge *m_prev;
+    CFGEdge m_prev;
 };
 
 // :BackwardNode
@@ -333,11 +367,12 @@ class BackwardNode : public virtual CFGNode {
  * \ingroup CFG
  *
  * \brief Represents a birectional node in the CFG, a node that moves forward
- * and backward. It combines the functionality of ForwardNode and BackwardNode.
- * Most nodes in the CFG are birectional Nodes
+ * and backward. It extends ForwardNode with the backward edge of BackwardNode,
+ * the hierarchy is kept free of virtual inheritance so that the nodes can be
+ * cast statically. Most nodes in the CFG are birectional Nodes
  *
  * */
-class BiDirectNode : public ForwardNode, public BackwardNode {
+class BiDirectNode : public ForwardNode {
   public:
     virtual ~BiDirectNode() = default;
 
@@ -345,6 +380,27 @@ class BiDirectNode : public ForwardNode, public BackwardNode {
         m_node_type = BiDirect;
         m_name = getNodeTypeName();
     }
+
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() >= BiDirect &&
+               node->getNodeType() <= LastBiDirect;
+    }
+
+    /**
+     * \return returns the previous node
+     */
+    auto getPrevious() -> CFGNode *const override;
+
+    /**
+     * \param node - node to be set
+     * \param edge_type - type of the edge(default = Complete)
+     * \return sets the previous node
+     */
+    auto setPrevious(CFGNode *node, CFGEdge::Edge edge_type = CFGEdge::Complete)
+        -> CFGNode * override;
+
+  protected:
+    CFGEdge m_prev;
 };
 
 // :BiDirect Node
@@ -362,6 +418,10 @@ class KernelFuncNode : public ForwardNode {
     KernelFuncNode(clang::ASTContext &ast_context,
                    const clang::FunctionDecl *func_decl);
 
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() == KernelFunc;
+    }
+
     /**
      * \return returns the name of the function
      */
@@ -387,7 +447,7 @@ class KernelFuncNode : public ForwardNode {
 
   private:
     const clang::FunctionDecl *m_func_decl;
-    CFGEdge *m_exit;
+    CFGEdge m_exit;
 
     // AST context
     clang::ASTContext &m_ast_context;
@@ -405,9 +465,14 @@ class KernelFuncNode : public ForwardNode {
  * */
 class ConditionalNode : public BiDirectNode {
   public:
-    virtual ~ConditionalNode() { delete reconv; }
+    virtual ~ConditionalNode() = default;
     ConditionalNode(clang::ASTContext &ast_context, const clang::Stmt *stmt);
 
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() >= Conditional &&
+               node->getNodeType() <= LastConditional;
+    }
+
     /**
      * \return returns the reconvergence node
      */
@@ -424,7 +489,8 @@ class ConditionalNode : public BiDirectNode {
   protected:
     clang::ASTContext &m_ast_context;
     const clang::Stmt *m_cond_stmt;
-    CFGEdge *true_b, *reconv;
+    /// the true edge is the forward edge m_next
+    CFGEdge m_reconv;
 };
 
 // :ConditionalNode
@@ -438,9 +504,13 @@ class ConditionalNode : public BiDirectNode {
  * */
 class IfStmtNode : public ConditionalNode {
   public:
-    ~IfStmtNode() { delete false_b; }
+    ~IfStmtNode() = default;
     IfStmtNode(clang::ASTContext &ast_context, const clang::IfStmt *if_stmt);
 
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() == IfStmt;
+    }
+
     /**
      * \return gets the If statement's AST node
      */
@@ -486,7 +556,7 @@ class IfStmtNode : public ConditionalNode {
         -> CFGNode *;
 
   private:
-    CFGEdge *false_b;
+    CFGEdge m_false;
 };
 
 // :IfStmt
@@ -505,6 +575,10 @@ class ForStmtNode : public ConditionalNode {
     ~ForStmtNode() = default;
     ForStmtNode(clang::ASTContext &ast_context, const clang::ForStmt *for_stmt);
 
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() == ForStmt;
+    }
+
     /// \return gets the For statement's AST node
     auto getForStmt() -> const clang::ForStmt *const {
         return llvm::cast<const clang::ForStmt>(m_cond_stmt);
@@ -527,6 +601,10 @@ class ReconvNode : public BiDirectNode {
     ~ReconvNode() = default;
     ReconvNode(ConditionalNode *cond_node);
 
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() == Reconv;
+    }
+
     /// \return returns null as the I don't find a reason to traverse back through the
     /// reconv node(subject to change)
     auto setPrevious(CFGNode *node, CFGEdge::Edge edge_type)
@@ -545,9 +623,6 @@ class ReconvNode : public BiDirectNode {
      * \return returns the conditional node
      */
     auto getBack() -> CFGNode *const;
-
-  private:
-    CFGEdge *back;
 };
 
 // :ReconvNode
@@ -564,8 +639,12 @@ class InternalNode : public BiDirectNode {
     ~InternalNode() = default;
     InternalNode(clang::ASTContext &ast_context, InternalNodeTy node);
 
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() == Internal;
+    }
+
     /// \return returns the source of the AST Node
-    auto getSource() -> std::string const override;
+    auto getSource() -> llvm::StringRef const override;
 
     /// \return returns the name of internal(name, source, source, typename) Node
     auto getInternalNodeName() -> std::string const;
@@ -611,6 +690,10 @@ class ExitNode : public BackwardNode {
   public:
     ~ExitNode() = default;
     ExitNode();
+
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() == Exit;
+    }
 };
 
 // :ExitNode
@@ -626,6 +709,10 @@ class ISPCBlockNode : public BiDirectNode {
     ~ISPCBlockNode() = default;
     ISPCBlockNode();
 
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() == ISPCBlock;
+    }
+
   private:
 };
 
@@ -641,6 +728,10 @@ class ISPCBlockExitNode : public BiDirectNode {
   public:
     ~ISPCBlockExitNode() = default;
     ISPCBlockExitNode();
+
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() == ISPCBlockExit;
+    }
 };
 
 // :ISPCBlockExitNode
@@ -655,6 +746,10 @@ class ISPCGridNode : public BiDirectNode {
   public:
     ~ISPCGridNode() = default;
     ISPCGridNode();
+
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() == ISPCGrid;
+    }
 };
 
 // :ISPCGridNode
@@ -669,10 +764,53 @@ class ISPCGridExitNode : public BiDirectNode {
   public:
     ~ISPCGridExitNode() = default;
     ISPCGridExitNode();
+
+    static auto classof(const CFGNode *node) -> bool {
+        return node->getNodeType() == ISPCGridExit;
+    }
 };
 
 // :ISPCGridExitNode
 
+/**
+ * \class CFGArena
+ * \ingroup CFG
+ *
+ * \brief Owns every node of the CFG of a translation unit. Nodes are bump
+ * allocated into contiguous slabs and their edges are stored inline, so a
+ * traversal touches few cache lines and tearing down the CFG releases the
+ * slabs at once. Nodes unlinked from the control flow stay in the arena until
+ * it is destroyed.
+ *
+ * */
+class CFGArena {
+  public:
+    CFGArena() = default;
+    CFGArena(const CFGArena &) = delete;
+    auto operator=(const CFGArena &) -> CFGArena & = delete;
+    ~CFGArena() {
+        // only the strings held by the nodes need destruction
+        for (auto node : m_nodes) {
+            node->~CFGNode();
+        }
+    }
+
+    /// \return a node of NodeTy constructed with args in the arena
+    template <typename NodeTy, typename... ArgsTy>
+    auto create(ArgsTy &&... args) -> NodeTy * {
+        NodeTy *node = new (m_allocator.Allocate<NodeTy>())
+            NodeTy(std::forward<ArgsTy>(args)...);
+        m_nodes.push_back(node);
+        return node;
+    }
+
+  private:
+    llvm::BumpPtrAllocator m_allocator;
+    std::vector<CFGNode *> m_nodes;
+};
+
+// :CFGArena
+
 /// removes a CFGNode from the control flow
 /// \param node to be removed
 /// \return node that was removed
@@ -23,7 +23,7 @@ template <typename Derived, typename RetTy> class CFGVisitor {
   public:
 #define DISPATCH(NAME)                                                         \
     return static_cast<Derived *>(this)->Visit##NAME##Node(                    \
-        dynamic_cast<NAME##Node *>(node))
+        llvm::cast<NAME##Node>(node))
 
 #define FALLBACK(NAME)                                                         \
     virtual RetTy Visit##NAME##Node(NAME##Node *node) { DISPATCH(CFG); }
@@ -7,5 +7,15 @@ extern const std::map<std::string, std::string> g_SpmdfyTypeMap;
 /// A Function map between CUDA atomics to ISPC atomics
 extern const std::map<std::string, std::string> g_SpmdfyAtomicMap;
 
-/// A Function map between CUDA MathIntrinsics to ISPC Math Functions
-extern const std::map<std::string, std::pair<bool, std::string>> g_SpmdfyMathInstrinsicsMap;
\ No newline at end of file
+/// A Function map between the associative CUDA atomics to the ISPC reduction
+/// combining the values of the gang before a single atomic
+extern const std::map<std::string, std::string> g_SpmdfyAtomicReduceMap;
+
+/// A Function map between CUDA warp intrinsics to ISPC cross-lane operations,
+/// a warp is mapped onto the gang
+extern const std::map<std::string, std::string> g_SpmdfyWarpMap;
+
+/// A Function map between the CUDA math API to ISPC math functions, the first
+/// one is used by default and the second one with --fast-math
+extern const std::map<std::string, std::pair<std::string, std::string>>
+    g_SpmdfyMathInstrinsicsMap;
\ No newline at end of file
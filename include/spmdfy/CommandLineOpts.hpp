@@ -1,8 +1,31 @@
+#ifndef SPMDFY_COMMANDLINEOPTS_HPP
+#define SPMDFY_COMMANDLINEOPTS_HPP
+
 #include <llvm/Support/CommandLine.h>
 
+/// how the generated ISPC is formatted before it is written
+enum class FormatMode { None, Fast, Clang };
+
 extern llvm::cl::OptionCategory spmdfy_options;
 extern llvm::cl::opt<std::string> output_filename;
 extern llvm::cl::opt<bool> verbosity;
 extern llvm::cl::opt<bool> toggle_ispc_macros;
 extern llvm::cl::opt<std::string> generate_ispc_macros;
-extern llvm::cl::opt<bool> generate_decls;
\ No newline at end of file
+extern llvm::cl::opt<bool> generate_decls;
+extern llvm::cl::opt<bool> ispc_tasks;
+extern llvm::cl::opt<bool> no_warp_block;
+extern llvm::cl::opt<unsigned> jobs;
+extern llvm::cl::opt<std::string> cache_dir;
+extern llvm::cl::opt<bool> generate_depfile;
+extern llvm::cl::opt<std::string> depfile;
+extern llvm::cl::opt<std::string> pch_cache_dir;
+extern llvm::cl::opt<FormatMode> format_mode;
+extern llvm::cl::opt<bool> group_atomics;
+extern llvm::cl::opt<bool> fast_math;
+extern llvm::cl::list<std::string> soa_records;
+extern llvm::cl::opt<unsigned> soa_width;
+extern llvm::cl::list<unsigned> block_dim;
+extern llvm::cl::opt<std::string> host_output;
+extern llvm::cl::list<std::string> host_includes;
+
+#endif
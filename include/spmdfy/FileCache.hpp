@@ -0,0 +1,75 @@
+/** \file FileCache.hpp
+ *  \brief A file system cache shared by the translation units transpiled in
+ * parallel
+ *
+ *  \author Pradeep Kumar  (schwarzschild-radius/@pt_of_no_return)
+ *  \bug No know bugs
+ *  \defgroup Frontend
+ * */
+
+#ifndef SPMDFY_FILECACHE_HPP
+#define SPMDFY_FILECACHE_HPP
+
+// llvm headers
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/VirtualFileSystem.h>
+
+// standard headers
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace spmdfy {
+
+/**
+ * \class FileCache
+ * \ingroup Frontend
+ *
+ * \brief Thread safe store of stat results and file contents keyed by the
+ * absolute path. Shared headers like cuda_utils.cuh are read from disk once
+ * for all the translation units.
+ *
+ * */
+class FileCache {
+  public:
+    /// \return cached status of the path, queries fs on a miss
+    auto status(const std::string &path, llvm::vfs::FileSystem &fs)
+        -> llvm::ErrorOr<llvm::vfs::Status>;
+
+    /// \return cached contents of the path, reads it through fs on a miss
+    auto buffer(const std::string &path, llvm::vfs::FileSystem &fs)
+        -> llvm::ErrorOr<const llvm::MemoryBuffer *>;
+
+  private:
+    std::mutex m_mutex;
+    std::map<std::string, llvm::ErrorOr<llvm::vfs::Status>> m_status;
+    std::map<std::string, std::unique_ptr<llvm::MemoryBuffer>> m_buffers;
+};
+
+/**
+ * \class CachedFileSystem
+ * \ingroup Frontend
+ *
+ * \brief A physical file system with its own working directory which serves
+ * reads from a FileCache. Every ClangTool gets its own instance as the
+ * FileManager and the working directory are not thread safe.
+ *
+ * */
+class CachedFileSystem : public llvm::vfs::ProxyFileSystem {
+  public:
+    explicit CachedFileSystem(FileCache &cache);
+
+    auto status(const llvm::Twine &path)
+        -> llvm::ErrorOr<llvm::vfs::Status> override;
+
+    auto openFileForRead(const llvm::Twine &path)
+        -> llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> override;
+
+  private:
+    FileCache &m_cache;
+};
+
+} // namespace spmdfy
+
+#endif
@@ -1,13 +1,14 @@
-#include "clang/Basic/Diagnostic.h"
-#include "clang/Basic/DiagnosticOptions.h"
-#include "clang/Basic/FileManager.h"
-#include "clang/Basic/SourceManager.h"
+#ifndef SPMDFY_FORMAT_HPP
+#define SPMDFY_FORMAT_HPP
+
 #include "clang/Basic/Version.h"
 #include "clang/Format/Format.h"
-#include "clang/Rewrite/Core/Rewriter.h"
 #include "llvm/Support/CommandLine.h"
-#include "llvm/Support/FileSystem.h"
-#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <spmdfy/CommandLineOpts.hpp>
+
+#include <string>
 
 using namespace llvm;
 using clang::tooling::Replacements;
@@ -18,9 +19,44 @@ namespace format {
 /**
  * \ingroup Frontend
  *
- * \brief formats the generated ISPC code using clang-format.
+ * \brief formats the generated ISPC code in place using clang-format. The
+ * Fast mode uses the LLVM style without sorting includes or breaking lines.
+ * FileName is only used to look up the .clang-format style
  *
+ * \return returns true on failure
  * */
-bool format(StringRef FileName);
+bool format(StringRef FileName, std::string &Code, FormatMode Mode);
+
+/**
+ * \class IndentingOStream
+ * \ingroup Frontend
+ *
+ * \brief Reindents every line written to it by the nesting of braces and the
+ * ISPC_*_START/ISPC_*_END macros, so the generated code is readable without
+ * running clang-format
+ *
+ * */
+class IndentingOStream : public llvm::raw_ostream {
+  public:
+    explicit IndentingOStream(llvm::raw_ostream &out,
+                              unsigned indent_width = 4)
+        : m_out(out), m_indent_width(indent_width) {}
+    ~IndentingOStream() override;
+
+  private:
+    void write_impl(const char *Ptr, size_t Size) override;
+    uint64_t current_pos() const override { return m_pos; }
+    /// writes the pending line indented by the current depth
+    void writeLine(bool Newline);
+
+    llvm::raw_ostream &m_out;
+    unsigned m_indent_width;
+    int m_depth = 0;
+    uint64_t m_pos = 0;
+    std::string m_line;
+};
+
 } // namespace format
-} // namespace spmdfy
\ No newline at end of file
+} // namespace spmdfy
+
+#endif
@@ -12,14 +12,19 @@
 #include <spmdfy/CFG/CFG.hpp>
 #include <spmdfy/CUDA2ISPC.hpp>
 #include <spmdfy/Logger.hpp>
+#include <spmdfy/Pass/PassWorkspace.hpp>
 #include <spmdfy/utils.hpp>
 
 #include <clang/AST/DeclVisitor.h>
 #include <clang/AST/RecursiveASTVisitor.h>
 #include <clang/AST/StmtVisitor.h>
 #include <clang/AST/TypeVisitor.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <llvm/Support/raw_ostream.h>
 #include <spmdfy/CFG/CFGVisitor.hpp>
 
+#include <array>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <variant>
@@ -32,41 +37,132 @@ namespace codegen {
  * \ingroup CodeGen
  *
  * \brief Generates Codegen by recursively visiting CFG and also AST to generate
- * code
+ * code. The CFG visitors stream the code into the output as they traverse,
+ * only the AST visitors of a single declaration or statement return strings
  *
  * */
 class CFGCodeGen : public clang::ConstDeclVisitor<CFGCodeGen, std::string>,
                    public clang::ConstStmtVisitor<CFGCodeGen, std::string>,
                    public clang::TypeVisitor<CFGCodeGen, std::string>,
-                   public cfg::CFGVisitor<CFGCodeGen, std::string> {
+                   public cfg::CFGVisitor<CFGCodeGen, void> {
     using clang::ConstDeclVisitor<CFGCodeGen, std::string>::Visit;
     using clang::ConstStmtVisitor<CFGCodeGen, std::string>::Visit;
     using clang::TypeVisitor<CFGCodeGen, std::string>::Visit;
-    using cfg::CFGVisitor<CFGCodeGen, std::string>::Visit;
+    using cfg::CFGVisitor<CFGCodeGen, void>::Visit;
 
   public:
     using OStreamTy = std::ostringstream;
 
     CFGCodeGen(clang::ASTContext &ast_context,
-               const std::vector<cfg::CFGNode *> &node)
+               const std::vector<cfg::CFGNode *> &node,
+               const pass::Workspace &workspace, llvm::raw_ostream &out)
         : m_ast_context(ast_context), m_sm(ast_context.getSourceManager()),
-          m_lang_opts(ast_context.getLangOpts()), m_node(node) {
+          m_lang_opts(ast_context.getLangOpts()), m_node(node),
+          m_workspace(workspace), m_out(out) {
         m_lang_opts.CPlusPlus = true;
         m_lang_opts.Bool = true;
     }
-    /// \return returns generated ISPC code
-    auto get() -> std::string const;
-
-    /// \return generated ISPC code from CFGNode
-    /// \param CFGNode*
-    auto getFrom(cfg::CFGNode *) -> std::string const;
+    /// generates the ISPC code of the translation unit into the output
+    auto emit() -> void;
 
     /// traverses the CFG
-    auto traverseCFG() -> std::string const;
+    auto traverseCFG() -> void;
+
+    /// generates the ISPC struct and, for a struct laid out as soa<>, the
+    /// exported functions converting its arrays from and to the host layout
+    /// \param CXXRecordDecl of a struct definition
+    auto emitRecord(const clang::CXXRecordDecl *) -> void;
 
     // ispc code generators
     auto getISPCBaseType(std::string type) -> std::string;
 
+    /// emits export function that launches the kernel's task over the grid
+    /// \param FunctionDecl of the kernel
+    auto emitTaskLauncher(const clang::FunctionDecl *) -> void;
+
+    /// emits the body of the kernel from the grid start to the grid end
+    /// \param KernelFuncNode of the kernel
+    auto emitKernelBody(cfg::KernelFuncNode *) -> void;
+
+    /// emits the body of the kernel for any block size, reading the spill
+    /// buffers sized for the runtime blockDim
+    /// \param KernelFuncNode of the kernel
+    auto emitGenericKernelBody(cfg::KernelFuncNode *) -> void;
+
+    /// emits the kernel owning the dynamic shared memory and the spill buffers
+    /// of the generic body, it allocates them, calls the body and frees them
+    /// \param FunctionDecl of the kernel
+    /// \param spilled variables of the kernel
+    /// \param block size the kernel is specialized for, which needs no spill
+    /// buffers
+    auto emitBufferOwner(const clang::FunctionDecl *,
+                         const std::vector<const clang::VarDecl *> &,
+                         const std::optional<std::array<unsigned, 3>> &)
+        -> void;
+
+    /// \return names of the template parameters of a kernel template
+    /// specialization and the ISPC source of their arguments
+    /// \param FunctionDecl of the kernel
+    auto getTemplateArgDefines(const clang::FunctionDecl *)
+        -> std::vector<std::pair<std::string, std::string>>;
+
+    /// \return block size the kernel is specialized for, from --block-dim or
+    /// __launch_bounds__
+    /// \param FunctionDecl of the kernel
+    auto getFixedBlockDim(const clang::FunctionDecl *)
+        -> std::optional<std::array<unsigned, 3>>;
+
+    /// \return source of the statement with coalesced subscripts rewritten
+    /// relative to programIndex, whole vectors of coalesced elements loaded and
+    /// stored wide and atomics, warp intrinsics and math functions mapped to
+    /// ISPC
+    /// \param Stmt in the kernel
+    auto rewriteSource(const clang::Stmt *) -> std::string;
+
+    /// \return true if the value of the whole vector is read, as opposed to
+    /// one of its members or the vector being assigned
+    /// \param Expr of a CUDA vector type
+    auto isWholeVectorRead(const clang::Expr *) -> bool;
+
+    /// \return true if the value of the expression is used by its context,
+    /// false if it is evaluated as a statement of its own
+    auto isResultUsed(const clang::Expr *) -> bool;
+
+    /// \return true if the expression is a statement of its own, so that it
+    /// can be replaced by a compound statement
+    auto isStatement(const clang::Expr *) -> bool;
+
+    /// \return ISPC cross-lane operation the CUDA warp intrinsic is mapped to
+    /// \param CallExpr of the warp intrinsic
+    /// \param source of the arguments as written, without the default ones
+    auto getWarpIntrinsic(const clang::CallExpr *,
+                          std::vector<std::string> args) -> std::string;
+
+    /// \return ISPC atomic the CUDA atomic is mapped to, a single atomic of
+    /// the reduced values of the gang when the address is uniform
+    /// \param CallExpr of the atomic
+    /// \param source of the arguments
+    /// \param rewriter holding the rewrites of the statement so far
+    auto getAtomic(const clang::CallExpr *,
+                   const std::vector<std::string> &args,
+                   clang::Rewriter &rewriter) -> std::string;
+
+    /// \return ISPC math function the CUDA one is mapped to, the fast
+    /// approximation with --fast-math
+    /// \param CallExpr of the math function
+    /// \param source of the arguments
+    auto getMathFunction(const clang::CallExpr *,
+                         const std::vector<std::string> &args) -> std::string;
+
+    /// \return declaration of the variable without the initializer
+    /// \param VarDecl of a spillable variable
+    auto getSpillDecl(const clang::VarDecl *) -> std::string;
+
+    /// \return element of the spill buffer of the variable holding the value
+    /// of the current program instance
+    /// \param VarDecl of a spilled variable
+    auto getSpillSlot(const clang::VarDecl *) -> std::string;
+
     // ispc code gen vistiors
 #define DECL_VISITOR(NODE)                                                     \
     auto Visit##NODE##Decl(const clang::NODE##Decl *)->std::string
@@ -77,11 +173,12 @@ class CFGCodeGen : public clang::ConstDeclVisitor<CFGCodeGen, std::string>,
 #define TYPE_VISITOR(NODE)                                                     \
     auto Visit##NODE##Type(const clang::NODE##Type *)->std::string
 #define CFGNODE_VISITOR(NODE)                                                  \
-    auto Visit##NODE##Node(cfg::NODE##Node *)->std::string
+    auto Visit##NODE##Node(cfg::NODE##Node *)->void
 
     DECL_VISITOR(Var);
     DECL_VISITOR(ParmVar);
     DECL_VISITOR(Function);
+    DECL_VISITOR(CXXRecord);
 
     EXPR_VISITOR(Call);
 
@@ -107,8 +204,12 @@ class CFGCodeGen : public clang::ConstDeclVisitor<CFGCodeGen, std::string>,
     clang::LangOptions m_lang_opts;
 
     cfg::CFGNode::Context m_tu_context;
+    bool m_warp_block = false;
+    bool m_fixed_block = false;
 
     const cfg::SpmdTUTy &m_node;
+    const pass::Workspace &m_workspace;
+    llvm::raw_ostream &m_out;
 };
 
 #undef CFGNODE_VISITOR
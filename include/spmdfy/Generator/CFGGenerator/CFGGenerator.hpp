@@ -17,6 +17,7 @@
 #include <vector>
 
 #include <clang/Analysis/CFG.h>
+#include <llvm/Support/raw_ostream.h>
 
 namespace spmdfy {
 /**
@@ -36,7 +37,7 @@ class CFGGenerator : public ISPCGenerator {
     using VariableMap =
         std::unordered_map<CUDAExprCategory, std::vector<std::string>>;
 
-    CFGGenerator(clang::ASTContext &context, std::ostringstream &file_writer)
+    CFGGenerator(clang::ASTContext &context, llvm::raw_ostream &file_writer)
         : m_context(context), m_sm(context.getSourceManager()),
           m_lang_opts(context.getLangOpts()), m_file_writer(file_writer) {
         m_lang_opts.CPlusPlus = true;
@@ -51,9 +52,10 @@ class CFGGenerator : public ISPCGenerator {
     clang::SourceManager &m_sm;
     clang::LangOptions m_lang_opts;
 
-    std::ostringstream &m_file_writer;
+    llvm::raw_ostream &m_file_writer;
 
     // CFG specific variables
+    cfg::CFGArena m_arena;
     std::vector<cfg::CFGNode *> m_spmd_tutbl;
 };
 
@@ -20,9 +20,9 @@ namespace spmdfy {
  * */
 class ConstructSpmdCFG : public clang::RecursiveASTVisitor<ConstructSpmdCFG> {
   public:
-    ConstructSpmdCFG(clang::ASTContext &context)
+    ConstructSpmdCFG(clang::ASTContext &context, cfg::CFGArena &arena)
         : m_context(context), m_sm(context.getSourceManager()),
-          m_lang_opts(context.getLangOpts()) {}
+          m_lang_opts(context.getLangOpts()), m_arena(arena) {}
 
     // Added nodes
     auto add(const clang::VarDecl *) -> bool;
@@ -32,6 +32,9 @@ class ConstructSpmdCFG : public clang::RecursiveASTVisitor<ConstructSpmdCFG> {
     auto splitEdge(cfg::CFGNode *node) -> bool;
 
     auto get() -> std::vector<cfg::CFGNode *>;
+
+    /// \return struct definitions of the translation unit, in order
+    auto getRecords() -> std::vector<const clang::CXXRecordDecl *>;
 // visitors
 #define DEF_VISITOR(NODE, BASE)                                                \
     auto Visit##NODE##BASE(clang::NODE##BASE *)->bool;
@@ -53,9 +56,10 @@ class ConstructSpmdCFG : public clang::RecursiveASTVisitor<ConstructSpmdCFG> {
     clang::LangOptions m_lang_opts;
 
     // CFG variables
+    cfg::CFGArena &m_arena;
     size_t m_stmt_count = 0;
     cfg::CFGNode *m_curr_node;
-    std::vector<const clang::Decl *> m_cpp_tutbl;
+    std::vector<const clang::CXXRecordDecl *> m_cpp_tutbl;
     std::vector<cfg::CFGNode *> m_spmdfy_tutbl;
 };
 } // namespace spmdfy
@@ -0,0 +1,55 @@
+#ifndef SPMDFY_HOSTGENERATOR_HPP
+#define SPMDFY_HOSTGENERATOR_HPP
+
+#include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <spmdfy/Generator/Generator.hpp>
+
+#include <string>
+
+namespace spmdfy {
+
+/**
+ * \class HostGenerator
+ * \ingroup CodeGen
+ *
+ * \brief Rewrites the host code of the main file for a plain C++ compiler.
+ * Every kernel launch queues the exported ISPC kernel on its stream through
+ * spmdfy_runtime and the bodies of the kernels and device functions are
+ * removed. A launch of a kernel taking soa<> arrays is an error, the host
+ * arrays have to be converted explicitly
+ *
+ * */
+class HostGenerator : public ISPCGenerator,
+                      public clang::RecursiveASTVisitor<HostGenerator> {
+  public:
+    HostGenerator(clang::ASTContext &context, llvm::raw_ostream &file_writer)
+        : m_context(context), m_sm(context.getSourceManager()),
+          m_lang_opts(context.getLangOpts()), m_file_writer(file_writer),
+          m_rewriter(m_sm, m_lang_opts) {}
+    auto handleTranslationUnit(clang::ASTContext &) -> bool override;
+
+    auto TraverseFunctionDecl(clang::FunctionDecl *) -> bool;
+    auto VisitCUDAKernelCallExpr(clang::CUDAKernelCallExpr *) -> bool;
+
+  private:
+    /// \return the grid or block dimension of a launch as an ispc::Dim3, an
+    /// integer n is promoted to {n, 1, 1}
+    auto getDim3(const clang::Expr *) -> std::string;
+
+    // AST specific variables
+    clang::ASTContext &m_context;
+    clang::SourceManager &m_sm;
+    clang::LangOptions m_lang_opts;
+
+    llvm::raw_ostream &m_file_writer;
+    clang::Rewriter m_rewriter;
+    /// set when a launch cannot be rewritten
+    bool m_failed = false;
+};
+
+} // namespace spmdfy
+
+#endif
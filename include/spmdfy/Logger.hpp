@@ -1,6 +1,8 @@
 #ifndef SPMDFY_LOGGER_HPP
 #define SPMDFY_LOGGER_HPP
 
+#include <llvm/ADT/StringRef.h>
+
 #include <memory>
 #include <spdlog/fmt/ostr.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
@@ -31,6 +33,13 @@ class Logger {
 };
 } // namespace spmdfy
 
+namespace llvm {
+/// lets the logger format source slices without copying them
+inline auto to_string_view(StringRef str) -> fmt::string_view {
+    return {str.data(), str.size()};
+}
+} // namespace llvm
+
 /**
  * \ingroup Utility
  *
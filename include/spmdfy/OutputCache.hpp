@@ -0,0 +1,107 @@
+/** \file OutputCache.hpp
+ *  \brief Content hash cache of the generated ISPC sources and the depfile
+ * emission for incremental builds
+ *
+ *  \author Pradeep Kumar  (schwarzschild-radius/@pt_of_no_return)
+ *  \bug No know bugs
+ *  \defgroup Frontend
+ * */
+
+#ifndef SPMDFY_OUTPUTCACHE_HPP
+#define SPMDFY_OUTPUTCACHE_HPP
+
+// clang headers
+#include <clang/Frontend/FrontendAction.h>
+#include <clang/Tooling/Tooling.h>
+
+// llvm headers
+#include <llvm/Support/MD5.h>
+
+// standard headers
+#include <string>
+#include <vector>
+
+namespace spmdfy {
+
+/**
+ * \class HashPreprocessedAction
+ * \ingroup Frontend
+ *
+ * \brief Runs only the preprocessor over the translation unit and hashes the
+ * contents of every file it enters. The user headers are recorded as the
+ * dependencies of the translation unit.
+ *
+ * */
+class HashPreprocessedAction : public clang::PreprocessorFrontendAction {
+  public:
+    HashPreprocessedAction(llvm::MD5 &hash,
+                           std::vector<std::string> &dependencies)
+        : m_hash(hash), m_dependencies(dependencies) {}
+
+    auto ExecuteAction() -> void override;
+
+  private:
+    llvm::MD5 &m_hash;
+    std::vector<std::string> &m_dependencies;
+};
+
+/**
+ * \class HashPreprocessedActionFactory
+ * \ingroup Frontend
+ *
+ * \brief A factory method to create a HashPreprocessedAction
+ *
+ * */
+class HashPreprocessedActionFactory
+    : public clang::tooling::FrontendActionFactory {
+  public:
+    HashPreprocessedActionFactory(llvm::MD5 &hash,
+                                  std::vector<std::string> &dependencies)
+        : m_hash(hash), m_dependencies(dependencies) {}
+
+    /// creates the frontend action
+    virtual auto create() -> clang::FrontendAction * override;
+
+  private:
+    llvm::MD5 &m_hash;
+    std::vector<std::string> &m_dependencies;
+};
+
+namespace cache {
+
+/**
+ * \ingroup Frontend
+ *
+ * \brief copies the cached ISPC source of key in cache_dir to output
+ * \return returns true on a cache hit
+ *
+ * */
+bool lookup(llvm::StringRef cache_dir, llvm::StringRef key,
+            llvm::StringRef output);
+
+/**
+ * \ingroup Frontend
+ *
+ * \brief stores output in cache_dir under key. The entry is written to a
+ * temporary file and renamed so that parallel spmdfy runs never observe a
+ * partial entry
+ *
+ * */
+void store(llvm::StringRef cache_dir, llvm::StringRef key,
+           llvm::StringRef output);
+
+/**
+ * \ingroup Frontend
+ *
+ * \brief writes a Makefile/Ninja depfile with target depending on
+ * dependencies
+ * \return returns true on failure
+ *
+ * */
+bool writeDepfile(llvm::StringRef depfile, llvm::StringRef target,
+                  const std::vector<std::string> &dependencies);
+
+} // namespace cache
+} // namespace spmdfy
+
+#endif
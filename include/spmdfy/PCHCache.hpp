@@ -0,0 +1,87 @@
+/** \file PCHCache.hpp
+ *  \brief Precompiled CUDA wrapper and runtime headers shared across the
+ * invocations of spmdfy
+ *
+ *  \author Pradeep Kumar  (schwarzschild-radius/@pt_of_no_return)
+ *  \bug No know bugs
+ *  \defgroup Frontend
+ * */
+
+#ifndef SPMDFY_PCHCACHE_HPP
+#define SPMDFY_PCHCACHE_HPP
+
+// clang headers
+#include <clang/Frontend/FrontendActions.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
+#include <clang/Tooling/CompilationDatabase.h>
+
+// llvm headers
+#include <llvm/Support/VirtualFileSystem.h>
+
+// standard headers
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace spmdfy {
+
+/**
+ * \class PCHCache
+ * \ingroup Frontend
+ *
+ * \brief Builds a precompiled header of the headers the CUDA driver includes
+ * implicitly(__clang_cuda_runtime_wrapper.h and the CUDA runtime headers it
+ * pulls in) once per compile command and hands out its path. The PCH is kept
+ * in the cache directory along with a stamp of its input files, a PCH whose
+ * inputs changed on disk is rebuilt instead of being rejected by clang.
+ *
+ * */
+class PCHCache {
+  public:
+    PCHCache(const std::string &cache_dir, std::string options_key);
+
+    /// \return path of the PCH for the compile command of src, built with the
+    /// arguments adjusted by adjuster. Returns an empty string when the PCH
+    /// could not be built
+    auto getPCH(const clang::tooling::CompilationDatabase &compilations,
+                const std::string &src,
+                const clang::tooling::ArgumentsAdjuster &adjuster,
+                llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> file_system)
+        -> std::string;
+
+  private:
+    auto buildPCH(const std::string &pch_path,
+                  const std::vector<std::string> &command_line,
+                  const clang::tooling::ArgumentsAdjuster &adjuster,
+                  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> file_system)
+        -> bool;
+
+    std::string m_cache_dir;
+    std::string m_options_key;
+    std::mutex m_mutex;
+    std::map<std::string, std::string> m_pchs;
+};
+
+/**
+ * \class GenerateStampedPCHAction
+ * \ingroup Frontend
+ *
+ * \brief Writes the PCH to pch_path and the size and modification time of
+ * every input file of the PCH to pch_path.stamp
+ *
+ * */
+class GenerateStampedPCHAction : public clang::GeneratePCHAction {
+  public:
+    explicit GenerateStampedPCHAction(std::string pch_path)
+        : m_pch_path(std::move(pch_path)) {}
+
+    auto BeginInvocation(clang::CompilerInstance &ci) -> bool override;
+    auto EndSourceFileAction() -> void override;
+
+  private:
+    std::string m_pch_path;
+};
+
+} // namespace spmdfy
+
+#endif
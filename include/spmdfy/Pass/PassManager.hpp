@@ -18,10 +18,14 @@
 
 // clang-format off
 #include <spmdfy/Pass/Passes/LocateASTNodes.hpp>
+#include <spmdfy/Pass/Passes/EliminateBarriers.hpp>
 #include <spmdfy/Pass/Passes/InsertISPCNodes.hpp>
 #include <spmdfy/Pass/Passes/HoistShmemNodes.hpp>
 #include <spmdfy/Pass/Passes/DuplicatePartialNodes.hpp>
 #include <spmdfy/Pass/Passes/DetectPartialNodes.hpp>
+#include <spmdfy/Pass/Passes/SpillLiveValues.hpp>
+#include <spmdfy/Pass/Passes/InferUniformNodes.hpp>
+#include <spmdfy/Pass/Passes/DetectCoalescedAccess.hpp>
 #include <spmdfy/Pass/Passes/PrintReverseCFGPass.hpp>
 #include <spmdfy/Pass/Passes/PrintCFGPass.hpp>
 // clang-format on
@@ -48,12 +52,14 @@ class PassManager {
   public:
     using SpmdTUTy = std::vector<cfg::CFGNode *>;
 
-    PassManager(clang::ASTContext &ast_context, SpmdTUTy &spmd_tutbl)
+    PassManager(clang::ASTContext &ast_context, SpmdTUTy &spmd_tutbl,
+                cfg::CFGArena &arena)
         : m_spmd_tutbl(spmd_tutbl), m_ast_context(ast_context),
           m_sm(ast_context.getSourceManager()),
           m_lang_opts(ast_context.getLangOpts()) {
         m_lang_opts.CPlusPlus = true;
         m_lang_opts.Bool = true;
+        m_workspace.arena = &arena;
         initPassSequence();
     }
 
@@ -63,6 +69,9 @@ class PassManager {
     /// run the sequence on the CFG
     auto runPassSequence() -> bool;
 
+    /// \return workspace filled by the pass sequence
+    auto getWorkspace() -> Workspace & { return m_workspace; }
+
   private:
     // AST Specfic variables
     clang::ASTContext &m_ast_context;
@@ -13,10 +13,14 @@ namespace pass {
 // clang-format off
 SEQUENCE_T(
            locate_ast_nodes_pass_t,
+           eliminate_barriers_pass_t,
            insert_ispc_nodes_pass_t,
            hoist_shmem_nodes_pass_t,
            detect_partial_nodes_pass_t,
            duplicate_partial_nodes_pass_t,
+           spill_live_values_pass_t,
+           infer_uniform_nodes_pass_t,
+           detect_coalesced_access_pass_t,
            print_reverse_cfg_pass_t,
            print_cfg_pass_t
 )
@@ -2,6 +2,7 @@
 #define PASS_WORKSPACE_HPP
 
 #include <queue>
+#include <set>
 #include <spmdfy/CFG/CFG.hpp>
 
 namespace spmdfy {
@@ -16,10 +17,28 @@ namespace pass {
  *
  * */
 struct Workspace {
+    /// arena owning the CFG, nodes inserted by passes are created in it
+    cfg::CFGArena *arena = nullptr;
     std::map<std::string, std::queue<cfg::InternalNode *>> syncthreads_queue;
     std::map<std::string, std::queue<cfg::InternalNode *>> shmem_queue;
     std::map<std::string, std::map<int, std::vector<cfg::InternalNode *>>>
         partial_nodes;
+    /// local variables proven to be uniform across the gang
+    std::set<const clang::VarDecl *> uniform_vars;
+    /// subscripts indexed by uniform_base + threadIdx.x mapped to their base
+    std::map<const clang::ArraySubscriptExpr *, std::string> coalesced_access;
+    /// thread private values live across a barrier, spilled to a buffer of
+    /// blockDim.x * blockDim.y * blockDim.z elements per variable
+    std::map<std::string, std::vector<const clang::VarDecl *>> spilled_vars;
+    /// spilled values reloaded at the start of an ISPCBlock region
+    std::map<const cfg::CFGNode *, std::vector<const clang::VarDecl *>>
+        spill_loads;
+    /// spilled values stored at the ISPCBlockExit of the region writing them
+    std::map<const cfg::CFGNode *, std::vector<const clang::VarDecl *>>
+        spill_stores;
+    /// variables written before being read in a region other than their own
+    std::map<const cfg::CFGNode *, std::vector<const clang::VarDecl *>>
+        redeclared_vars;
 };
 
 } // namespace pass
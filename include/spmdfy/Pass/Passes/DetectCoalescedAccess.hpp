@@ -0,0 +1,23 @@
+#ifndef DETECT_COALESCED_ACCESS_HPP
+#define DETECT_COALESCED_ACCESS_HPP
+
+#include <clang/AST/Expr.h>
+#include <clang/AST/ExprCXX.h>
+#include <spmdfy/CFG/RecursiveCFGVisitor.hpp>
+#include <spmdfy/Pass/PassHandler.hpp>
+
+namespace spmdfy {
+
+namespace pass {
+
+/// \return true if the expression is the CUDA builtin threadIdx.x
+bool isThreadIdxX(const clang::Expr *expr);
+
+bool detectCoalescedAccess(SpmdTUTy &, clang::ASTContext &, Workspace &);
+
+PASS(detectCoalescedAccess, detect_coalesced_access_pass_t);
+
+} // namespace pass
+} // namespace spmdfy
+
+#endif
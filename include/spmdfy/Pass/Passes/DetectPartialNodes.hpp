@@ -4,6 +4,7 @@
 #include <clang/AST/Expr.h>
 #include <spmdfy/CFG/RecursiveCFGVisitor.hpp>
 #include <spmdfy/Pass/PassHandler.hpp>
+#include <spmdfy/Pass/Passes/SpillLiveValues.hpp>
 
 namespace spmdfy {
 
@@ -0,0 +1,19 @@
+#ifndef ELIMINATE_BARRIERS_HPP
+#define ELIMINATE_BARRIERS_HPP
+
+#include <clang/AST/Expr.h>
+#include <spmdfy/CFG/RecursiveCFGVisitor.hpp>
+#include <spmdfy/Pass/PassHandler.hpp>
+
+namespace spmdfy {
+
+namespace pass {
+
+bool eliminateBarriers(SpmdTUTy &, clang::ASTContext &, Workspace &);
+
+PASS(eliminateBarriers, eliminate_barriers_pass_t);
+
+} // namespace pass
+} // namespace spmdfy
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef INFER_UNIFORM_NODES_HPP
+#define INFER_UNIFORM_NODES_HPP
+
+#include <clang/AST/Expr.h>
+#include <clang/AST/ExprCXX.h>
+#include <spmdfy/CFG/RecursiveCFGVisitor.hpp>
+#include <spmdfy/Pass/PassHandler.hpp>
+
+namespace spmdfy {
+
+namespace pass {
+
+/**
+ * \ingroup Pass
+ *
+ * \brief Returns true if the expression evaluates to the same value on every
+ * program instance of the gang i.e. it only depends on blockIdx, blockDim,
+ * gridDim, uniform kernel parameters, constants and the variables in uniform
+ * */
+bool isUniformExpr(const clang::Stmt *stmt,
+                   const std::set<const clang::VarDecl *> &uniform);
+
+/**
+ * \ingroup Pass
+ *
+ * \brief Returns true if the pointer expression points to the same address on
+ * every program instance of the gang i.e. the address of a global or shared
+ * variable or of an element at a uniform index of a uniform pointer
+ * */
+bool isUniformAddress(const clang::Expr *addr,
+                      const std::set<const clang::VarDecl *> &uniform);
+
+/**
+ * \ingroup Pass
+ *
+ * \brief Returns true if a variable bound to the reference type may be
+ * written through it, like a variable whose address is taken
+ * */
+bool isMutableReference(clang::QualType type);
+
+bool inferUniformNodes(SpmdTUTy &, clang::ASTContext &, Workspace &);
+
+PASS(inferUniformNodes, infer_uniform_nodes_pass_t);
+
+} // namespace pass
+} // namespace spmdfy
+
+#endif
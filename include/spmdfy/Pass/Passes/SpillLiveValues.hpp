@@ -0,0 +1,36 @@
+#ifndef SPILL_LIVE_VALUES_HPP
+#define SPILL_LIVE_VALUES_HPP
+
+#include <clang/AST/Expr.h>
+#include <spmdfy/CFG/RecursiveCFGVisitor.hpp>
+#include <spmdfy/Pass/PassHandler.hpp>
+
+namespace spmdfy {
+
+namespace pass {
+
+/**
+ * \ingroup Pass
+ *
+ * \brief Returns true if the value of the kernel scope variable can be
+ * carried across a barrier in a spill buffer i.e. it is a thread private
+ * scalar
+ * */
+bool isSpillableVar(const clang::VarDecl *var_decl);
+
+/**
+ * \ingroup Pass
+ *
+ * \brief Computes the spillable variables live across each barrier split of
+ * the block regions. They are stored to a per block structure-of-arrays buffer
+ * at the end of the region defining them and reloaded at the start of the
+ * regions they are live into
+ * */
+bool spillLiveValues(SpmdTUTy &, clang::ASTContext &, Workspace &);
+
+PASS(spillLiveValues, spill_live_values_pass_t);
+
+} // namespace pass
+} // namespace spmdfy
+
+#endif
@@ -21,6 +21,7 @@
 
 // llvm headers
 #include <llvm/Support/Debug.h>
+#include <llvm/Support/raw_ostream.h>
 
 // standard headers
 #include <algorithm>
@@ -34,6 +35,7 @@
 
 // spmdfy headers
 #include <spmdfy/Generator/CFGGenerator/CFGGenerator.hpp>
+#include <spmdfy/Generator/HostGenerator.hpp>
 #include <spmdfy/Generator/SimpleGenerator.hpp>
 #include <spmdfy/utils.hpp>
 
@@ -54,10 +56,15 @@ namespace spmdfy {
 class SpmdfyConsumer : public clang::ASTConsumer {
   public:
     explicit SpmdfyConsumer(clang::ASTContext *m_context,
-                            std::ostringstream &file_writer)
+                            llvm::raw_ostream &file_writer,
+                            llvm::raw_ostream *host_writer = nullptr)
         : m_context(*m_context), m_sm(m_context->getSourceManager()) {
         this->m_lang_opts = m_context->getLangOpts();
         this->gen = llvm::make_unique<CFGGenerator>(*m_context, file_writer);
+        if (host_writer) {
+            this->host_gen =
+                llvm::make_unique<HostGenerator>(*m_context, *host_writer);
+        }
     }
 
     /// creates the handle translation unit and passes it to the codegen methods
@@ -65,6 +72,8 @@ class SpmdfyConsumer : public clang::ASTConsumer {
 
   private:
     std::unique_ptr<ISPCGenerator> gen;
+    /// rewrites the host code, only when it is written
+    std::unique_ptr<ISPCGenerator> host_gen;
     clang::ASTContext &m_context;
     clang::SourceManager &m_sm;
     clang::LangOptions m_lang_opts;
@@ -82,8 +91,9 @@ class SpmdfyConsumer : public clang::ASTConsumer {
 class SpmdfyAction : public clang::ASTFrontendAction {
 
   public:
-    SpmdfyAction(std::ostringstream &file_writer)
-        : m_file_writer(file_writer) {}
+    SpmdfyAction(llvm::raw_ostream &file_writer,
+                 llvm::raw_ostream *host_writer = nullptr)
+        : m_file_writer(file_writer), m_host_writer(host_writer) {}
     virtual auto CreateASTConsumer(clang::CompilerInstance &Compiler,
                                    llvm::StringRef InFile)
         -> std::unique_ptr<clang::ASTConsumer> override;
@@ -100,7 +110,8 @@ class SpmdfyAction : public clang::ASTFrontendAction {
                             clang::SrcMgr::CharacteristicKind FileType) -> void;
 
   private:
-    std::ostringstream &m_file_writer;
+    llvm::raw_ostream &m_file_writer;
+    llvm::raw_ostream *m_host_writer;
 };
 
 /**
@@ -7,6 +7,8 @@
 #include <clang/Lex/Lexer.h>
 
 // llvm headers
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringRef.h>
 #include <llvm/Support/Path.h>
 
 // standard header
@@ -15,11 +17,65 @@
 
 namespace spmdfy {
 
+/**
+ * \class SourceSlicer
+ * \ingroup Utility
+ *
+ * \brief Per translation unit cache of source slices. The char range of a
+ * source range is resolved through the Lexer once and handed out as a view
+ * into the SourceManager's buffer afterwards. A slicer is active on the
+ * creating thread for its lifetime and sourceSlice/sourceDump on its
+ * SourceManager go through it.
+ *
+ * */
+class SourceSlicer {
+  public:
+    SourceSlicer(const clang::SourceManager &sm,
+                 const clang::LangOptions &lang_opts);
+    SourceSlicer(const SourceSlicer &) = delete;
+    auto operator=(const SourceSlicer &) -> SourceSlicer & = delete;
+    ~SourceSlicer();
+
+    /// \return the source between begin and the end of the token at end
+    auto slice(clang::SourceLocation begin, clang::SourceLocation end)
+        -> llvm::StringRef;
+
+    /// \return the slicer active on this thread for sm, nullptr if none
+    static auto getActive(const clang::SourceManager &sm) -> SourceSlicer *;
+
+  private:
+    const clang::SourceManager &m_sm;
+    clang::LangOptions m_lang_opts;
+    llvm::DenseMap<std::pair<unsigned, unsigned>, llvm::StringRef> m_slices;
+    SourceSlicer *m_enclosing;
+};
+
+/**
+ * \ingroup Utility
+ *
+ * \brief Slices the source file with the location specified by begin and end.
+ * It uses the clang's Lexer interface to find the end of the last token, the
+ * result is cached by the active SourceSlicer
+ *
+ * */
+llvm::StringRef sourceSlice(const clang::SourceManager &sm,
+                            const clang::LangOptions &lang_opt,
+                            const clang::SourceLocation &begin,
+                            const clang::SourceLocation &end);
+
+/// a wrapper method to sourceSlice for any ASTNode provided
+template <typename AstNode>
+llvm::StringRef sourceSlice(const clang::SourceManager &sm,
+                            const clang::LangOptions &lang_opt, AstNode node) {
+    return sourceSlice(sm, lang_opt, node->getSourceRange().getBegin(),
+                       node->getSourceRange().getEnd());
+}
+
 /**
  * \ingroup Utility
  *
  * \brief Dumps a string from the source file with the location specified by
- * begin and end. It uses the clang's Lexer interface to dump the source
+ * begin and end. A copy of sourceSlice
  *
  * */
 std::string sourceDump(const clang::SourceManager &sm,
@@ -83,6 +139,9 @@ std::string getAbsoluteFilePath(const std::string &sFile, std::error_code &EC);
 
 /// Macro the the source dump function
 #define SRCDUMP(NODE) sourceDump(m_sm, m_lang_opts, NODE)
+
+/// Macro the the source slice function, prefer it where no copy is needed
+#define SRCSLICE(NODE) sourceSlice(m_sm, m_lang_opts, NODE)
 } // namespace spmdfy
 
 #endif
\ No newline at end of file
@@ -0,0 +1,131 @@
+/** \file cuda_runtime.h
+ *  \brief Stand-in for the CUDA runtime API which lets the host code written
+ * by spmdfy --host-output compile with a plain C++ compiler and link against
+ * spmdfy_runtime. Device memory is host memory. Every stream is an in-order
+ * queue executed on a pool of worker threads, so the work of independent
+ * streams runs concurrently, and the NULL stream has the legacy default
+ * stream semantics.
+ * */
+
+#ifndef SPMDFY_CUDA_RUNTIME_H
+#define SPMDFY_CUDA_RUNTIME_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+
+#define __global__
+#define __device__
+#define __host__
+#define __shared__
+#define __constant__
+#define __managed__
+#define __forceinline__ inline
+#define __launch_bounds__(...)
+
+struct dim3 {
+    unsigned int x, y, z;
+    constexpr dim3(unsigned int x = 1, unsigned int y = 1, unsigned int z = 1)
+        : x(x), y(y), z(z) {}
+};
+
+enum cudaError {
+    cudaSuccess = 0,
+    cudaErrorInvalidValue = 1,
+    cudaErrorMemoryAllocation = 2,
+    cudaErrorInvalidResourceHandle = 400,
+    cudaErrorNotReady = 600
+};
+typedef enum cudaError cudaError_t;
+
+enum cudaMemcpyKind {
+    cudaMemcpyHostToHost = 0,
+    cudaMemcpyHostToDevice = 1,
+    cudaMemcpyDeviceToHost = 2,
+    cudaMemcpyDeviceToDevice = 3,
+    cudaMemcpyDefault = 4
+};
+
+/// work on a blocking stream is ordered with the NULL stream
+#define cudaStreamDefault 0x00
+#define cudaStreamNonBlocking 0x01
+
+#define cudaEventDefault 0x00
+#define cudaEventBlockingSync 0x01
+#define cudaEventDisableTiming 0x02
+
+typedef struct CUstream_st *cudaStream_t;
+typedef struct CUevent_st *cudaEvent_t;
+typedef void (*cudaHostFn_t)(void *user_data);
+
+// memory
+inline cudaError_t cudaMalloc(void **ptr, size_t size) {
+    *ptr = std::malloc(size);
+    return *ptr || !size ? cudaSuccess : cudaErrorMemoryAllocation;
+}
+
+template <typename T> inline cudaError_t cudaMalloc(T **ptr, size_t size) {
+    return cudaMalloc(reinterpret_cast<void **>(ptr), size);
+}
+
+inline cudaError_t cudaMallocHost(void **ptr, size_t size) {
+    return cudaMalloc(ptr, size);
+}
+
+template <typename T> inline cudaError_t cudaMallocHost(T **ptr, size_t size) {
+    return cudaMalloc(reinterpret_cast<void **>(ptr), size);
+}
+
+/// synchronizes the device before the memory is released
+cudaError_t cudaFree(void *ptr);
+cudaError_t cudaFreeHost(void *ptr);
+cudaError_t cudaMemcpy(void *dst, const void *src, size_t count,
+                       cudaMemcpyKind kind);
+cudaError_t cudaMemcpyAsync(void *dst, const void *src, size_t count,
+                            cudaMemcpyKind kind, cudaStream_t stream = 0);
+cudaError_t cudaMemset(void *ptr, int value, size_t count);
+cudaError_t cudaMemsetAsync(void *ptr, int value, size_t count,
+                            cudaStream_t stream = 0);
+
+// streams
+cudaError_t cudaStreamCreate(cudaStream_t *stream);
+cudaError_t cudaStreamCreateWithFlags(cudaStream_t *stream,
+                                      unsigned int flags);
+/// waits for the work of the stream before it is released
+cudaError_t cudaStreamDestroy(cudaStream_t stream);
+cudaError_t cudaStreamSynchronize(cudaStream_t stream);
+cudaError_t cudaStreamQuery(cudaStream_t stream);
+cudaError_t cudaStreamWaitEvent(cudaStream_t stream, cudaEvent_t event,
+                                unsigned int flags = 0);
+cudaError_t cudaLaunchHostFunc(cudaStream_t stream, cudaHostFn_t fn,
+                               void *user_data);
+
+// events
+cudaError_t cudaEventCreate(cudaEvent_t *event);
+cudaError_t cudaEventCreateWithFlags(cudaEvent_t *event, unsigned int flags);
+cudaError_t cudaEventDestroy(cudaEvent_t event);
+cudaError_t cudaEventRecord(cudaEvent_t event, cudaStream_t stream = 0);
+cudaError_t cudaEventQuery(cudaEvent_t event);
+cudaError_t cudaEventSynchronize(cudaEvent_t event);
+cudaError_t cudaEventElapsedTime(float *ms, cudaEvent_t start,
+                                 cudaEvent_t end);
+
+// device
+cudaError_t cudaDeviceSynchronize();
+cudaError_t cudaGetLastError();
+cudaError_t cudaPeekAtLastError();
+const char *cudaGetErrorString(cudaError_t error);
+
+/// enqueues the work on the stream, work on the NULL stream runs on the
+/// calling thread once the blocking streams are idle
+cudaError_t spmdfyEnqueue(cudaStream_t stream, std::function<void()> work);
+
+/// launches an ISPC kernel on the stream, the arguments are copied at the
+/// launch like the arguments of a CUDA kernel
+template <typename Kernel, typename... Args>
+inline cudaError_t spmdfyLaunchKernel(cudaStream_t stream, Kernel kernel,
+                                      Args... args) {
+    return spmdfyEnqueue(stream, std::bind(kernel, args...));
+}
+
+#endif
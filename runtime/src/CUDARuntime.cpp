@@ -0,0 +1,489 @@
+#include <cuda_runtime.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// an event completes when the last work recorded into it has run
+struct CUevent_st : std::enable_shared_from_this<CUevent_st> {
+    unsigned int flags = cudaEventDefault;
+    // the nth record completes the event's nth generation, the records of
+    // different streams may complete out of order
+    uint64_t recorded = 0;
+    std::set<uint64_t> pending;
+    // the latest generation which completed and when
+    uint64_t timed = 0;
+    std::chrono::steady_clock::time_point time;
+    // streams parked on a wait for a generation which has not completed
+    std::vector<cudaStream_t> waiting;
+};
+
+struct CUstream_st {
+    /// an item of the in-order queue, either work for the worker pool, the
+    /// record of an event or a wait for an event
+    struct Item {
+        enum class Kind { Work, Record, Wait };
+        Kind kind;
+        std::function<void()> work;
+        std::shared_ptr<CUevent_st> event;
+        uint64_t generation;
+    };
+
+    unsigned int flags = cudaStreamDefault;
+    std::deque<Item> queue;
+    // the head of the queue is running on a worker
+    bool running = false;
+    uint64_t submitted = 0;
+    uint64_t finished = 0;
+};
+
+namespace {
+
+/// \return true if the generation of the event has completed, the 0th one
+/// of an event which was never recorded is always complete
+auto isComplete(cudaEvent_t event, uint64_t generation) -> bool {
+    return !event->pending.count(generation);
+}
+
+/**
+ * \class Runtime
+ *
+ * \brief Owns the streams, events and the worker pool. A stream hands the
+ * work at its head to the pool and the next item is scheduled only after it
+ * finished, so every stream runs in order while different streams run on
+ * different workers. Records and waits are resolved under the lock without
+ * occupying a worker.
+ *
+ * */
+class Runtime {
+  public:
+    Runtime() {
+        unsigned num_workers = std::thread::hardware_concurrency();
+        if (const char *threads = std::getenv("SPMDFY_RUNTIME_THREADS")) {
+            num_workers = std::strtoul(threads, nullptr, 10);
+        }
+        num_workers = std::max(1u, num_workers);
+        for (unsigned i = 0; i < num_workers; i++) {
+            m_workers.emplace_back([this] { runWorker(); });
+        }
+    }
+
+    ~Runtime() {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [this] { return isIdle(false); });
+            m_stop = true;
+        }
+        m_ready_cv.notify_all();
+        for (auto &worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    auto createStream(unsigned int flags) -> cudaStream_t {
+        std::unique_ptr<CUstream_st> stream(new CUstream_st());
+        stream->flags = flags;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        cudaStream_t handle = stream.get();
+        m_streams.emplace(handle, std::move(stream));
+        return handle;
+    }
+
+    auto destroyStream(cudaStream_t stream) -> cudaError_t {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto found = m_streams.find(stream);
+        if (found == m_streams.end()) {
+            return cudaErrorInvalidResourceHandle;
+        }
+        uint64_t submitted = stream->submitted;
+        m_done.wait(lock, [=] { return stream->finished >= submitted; });
+        m_streams.erase(found);
+        return cudaSuccess;
+    }
+
+    auto createEvent(unsigned int flags) -> cudaEvent_t {
+        auto event = std::make_shared<CUevent_st>();
+        event->flags = flags;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.emplace(event.get(), event);
+        return event.get();
+    }
+
+    /// the event is released once the pending records and waits ran
+    auto destroyEvent(cudaEvent_t event) -> cudaError_t {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_events.erase(event) ? cudaSuccess
+                                     : cudaErrorInvalidResourceHandle;
+    }
+
+    auto enqueue(cudaStream_t stream, std::function<void()> work)
+        -> cudaError_t {
+        if (!stream) {
+            synchronizeLegacy();
+            work();
+            return cudaSuccess;
+        }
+        return push(stream, {CUstream_st::Item::Kind::Work, std::move(work),
+                             nullptr, 0});
+    }
+
+    auto record(cudaEvent_t event, cudaStream_t stream) -> cudaError_t {
+        if (!stream) {
+            synchronizeLegacy();
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_events.count(event) || (stream && !m_streams.count(stream))) {
+            return cudaErrorInvalidResourceHandle;
+        }
+        uint64_t generation = ++event->recorded;
+        event->pending.insert(generation);
+        if (!stream) {
+            completeEvent(event, generation);
+            return cudaSuccess;
+        }
+        pushLocked(stream, {CUstream_st::Item::Kind::Record, nullptr,
+                            event->shared_from_this(), generation});
+        return cudaSuccess;
+    }
+
+    /// the stream waits for the last record of the event issued so far
+    auto wait(cudaStream_t stream, cudaEvent_t event) -> cudaError_t {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_events.count(event) || (stream && !m_streams.count(stream))) {
+            return cudaErrorInvalidResourceHandle;
+        }
+        uint64_t generation = event->recorded;
+        if (!stream) {
+            m_done.wait(lock, [=] { return isComplete(event, generation); });
+            return cudaSuccess;
+        }
+        pushLocked(stream, {CUstream_st::Item::Kind::Wait, nullptr,
+                            event->shared_from_this(), generation});
+        return cudaSuccess;
+    }
+
+    auto synchronizeStream(cudaStream_t stream) -> cudaError_t {
+        if (!stream) {
+            synchronizeLegacy();
+            return cudaSuccess;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_streams.count(stream)) {
+            return cudaErrorInvalidResourceHandle;
+        }
+        uint64_t submitted = stream->submitted;
+        m_done.wait(lock, [=] { return stream->finished >= submitted; });
+        return cudaSuccess;
+    }
+
+    auto queryStream(cudaStream_t stream) -> cudaError_t {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!stream) {
+            return isIdle(true) ? cudaSuccess : cudaErrorNotReady;
+        }
+        if (!m_streams.count(stream)) {
+            return cudaErrorInvalidResourceHandle;
+        }
+        return stream->finished == stream->submitted ? cudaSuccess
+                                                     : cudaErrorNotReady;
+    }
+
+    auto synchronizeEvent(cudaEvent_t event) -> cudaError_t {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_events.count(event)) {
+            return cudaErrorInvalidResourceHandle;
+        }
+        uint64_t generation = event->recorded;
+        m_done.wait(lock, [=] { return isComplete(event, generation); });
+        return cudaSuccess;
+    }
+
+    auto queryEvent(cudaEvent_t event) -> cudaError_t {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_events.count(event)) {
+            return cudaErrorInvalidResourceHandle;
+        }
+        return isComplete(event, event->recorded) ? cudaSuccess
+                                                  : cudaErrorNotReady;
+    }
+
+    auto elapsedTime(float *ms, cudaEvent_t start, cudaEvent_t end)
+        -> cudaError_t {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_events.count(start) || !m_events.count(end) ||
+            !start->recorded || !end->recorded ||
+            ((start->flags | end->flags) & cudaEventDisableTiming)) {
+            return cudaErrorInvalidResourceHandle;
+        }
+        if (!isComplete(start, start->recorded) ||
+            !isComplete(end, end->recorded)) {
+            return cudaErrorNotReady;
+        }
+        *ms = std::chrono::duration<float, std::milli>(end->time - start->time)
+                  .count();
+        return cudaSuccess;
+    }
+
+    auto synchronizeDevice() -> void {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return isIdle(false); });
+    }
+
+  private:
+    /// work on the NULL stream waits for the work of every blocking stream
+    auto synchronizeLegacy() -> void {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return isIdle(true); });
+    }
+
+    /// \return true if no stream, or no blocking stream, has pending work
+    auto isIdle(bool blocking_only) -> bool {
+        for (const auto &stream : m_streams) {
+            if ((!blocking_only ||
+                 !(stream.first->flags & cudaStreamNonBlocking)) &&
+                stream.first->finished != stream.first->submitted) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    auto push(cudaStream_t stream, CUstream_st::Item item) -> cudaError_t {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_streams.count(stream)) {
+            return cudaErrorInvalidResourceHandle;
+        }
+        pushLocked(stream, std::move(item));
+        return cudaSuccess;
+    }
+
+    auto pushLocked(cudaStream_t stream, CUstream_st::Item item) -> void {
+        stream->submitted++;
+        stream->queue.push_back(std::move(item));
+        schedule(stream);
+    }
+
+    /// resolves the records and satisfied waits at the head of the stream
+    /// and hands the first work to the pool, must be called with the lock
+    auto schedule(cudaStream_t stream) -> void {
+        while (!stream->running && !stream->queue.empty()) {
+            auto &item = stream->queue.front();
+            switch (item.kind) {
+            case CUstream_st::Item::Kind::Work:
+                stream->running = true;
+                m_ready.push_back(stream);
+                m_ready_cv.notify_one();
+                return;
+            case CUstream_st::Item::Kind::Record:
+                completeEvent(item.event.get(), item.generation);
+                break;
+            case CUstream_st::Item::Kind::Wait:
+                if (!isComplete(item.event.get(), item.generation)) {
+                    auto &waiting = item.event->waiting;
+                    if (std::find(waiting.begin(), waiting.end(), stream) ==
+                        waiting.end()) {
+                        waiting.push_back(stream);
+                    }
+                    return;
+                }
+                break;
+            }
+            stream->queue.pop_front();
+            stream->finished++;
+            m_done.notify_all();
+        }
+    }
+
+    /// completes one generation, a stream waiting for an earlier one keeps
+    /// waiting until the stream which recorded it got there
+    auto completeEvent(cudaEvent_t event, uint64_t generation) -> void {
+        event->pending.erase(generation);
+        if (generation > event->timed) {
+            event->timed = generation;
+            event->time = std::chrono::steady_clock::now();
+        }
+        std::vector<cudaStream_t> waiting;
+        std::swap(waiting, event->waiting);
+        for (auto stream : waiting) {
+            schedule(stream);
+        }
+        m_done.notify_all();
+    }
+
+    auto runWorker() -> void {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_ready_cv.wait(lock,
+                            [this] { return m_stop || !m_ready.empty(); });
+            if (m_ready.empty()) {
+                return;
+            }
+            cudaStream_t stream = m_ready.front();
+            m_ready.pop_front();
+            auto work = std::move(stream->queue.front().work);
+            lock.unlock();
+            work();
+            lock.lock();
+            stream->queue.pop_front();
+            stream->finished++;
+            stream->running = false;
+            schedule(stream);
+            m_done.notify_all();
+        }
+    }
+
+    std::mutex m_mutex;
+    // signalled when an item of a stream finished or an event completed
+    std::condition_variable m_done;
+    std::condition_variable m_ready_cv;
+    std::deque<cudaStream_t> m_ready;
+    std::unordered_map<cudaStream_t, std::unique_ptr<CUstream_st>> m_streams;
+    std::unordered_map<cudaEvent_t, std::shared_ptr<CUevent_st>> m_events;
+    std::vector<std::thread> m_workers;
+    bool m_stop = false;
+};
+
+auto getRuntime() -> Runtime & {
+    static Runtime runtime;
+    return runtime;
+}
+
+} // namespace
+
+cudaError_t cudaFree(void *ptr) {
+    getRuntime().synchronizeDevice();
+    std::free(ptr);
+    return cudaSuccess;
+}
+
+cudaError_t cudaFreeHost(void *ptr) { return cudaFree(ptr); }
+
+cudaError_t cudaMemcpy(void *dst, const void *src, size_t count,
+                       cudaMemcpyKind kind) {
+    return cudaMemcpyAsync(dst, src, count, kind, 0);
+}
+
+cudaError_t cudaMemcpyAsync(void *dst, const void *src, size_t count,
+                            cudaMemcpyKind, cudaStream_t stream) {
+    return spmdfyEnqueue(stream, [=] { std::memmove(dst, src, count); });
+}
+
+cudaError_t cudaMemset(void *ptr, int value, size_t count) {
+    return cudaMemsetAsync(ptr, value, count, 0);
+}
+
+cudaError_t cudaMemsetAsync(void *ptr, int value, size_t count,
+                            cudaStream_t stream) {
+    return spmdfyEnqueue(stream, [=] { std::memset(ptr, value, count); });
+}
+
+cudaError_t cudaStreamCreate(cudaStream_t *stream) {
+    return cudaStreamCreateWithFlags(stream, cudaStreamDefault);
+}
+
+cudaError_t cudaStreamCreateWithFlags(cudaStream_t *stream,
+                                      unsigned int flags) {
+    if (!stream) {
+        return cudaErrorInvalidValue;
+    }
+    *stream = getRuntime().createStream(flags);
+    return cudaSuccess;
+}
+
+cudaError_t cudaStreamDestroy(cudaStream_t stream) {
+    return getRuntime().destroyStream(stream);
+}
+
+cudaError_t cudaStreamSynchronize(cudaStream_t stream) {
+    return getRuntime().synchronizeStream(stream);
+}
+
+cudaError_t cudaStreamQuery(cudaStream_t stream) {
+    return getRuntime().queryStream(stream);
+}
+
+cudaError_t cudaStreamWaitEvent(cudaStream_t stream, cudaEvent_t event,
+                                unsigned int) {
+    return getRuntime().wait(stream, event);
+}
+
+cudaError_t cudaLaunchHostFunc(cudaStream_t stream, cudaHostFn_t fn,
+                               void *user_data) {
+    return spmdfyEnqueue(stream, [=] { fn(user_data); });
+}
+
+cudaError_t cudaEventCreate(cudaEvent_t *event) {
+    return cudaEventCreateWithFlags(event, cudaEventDefault);
+}
+
+cudaError_t cudaEventCreateWithFlags(cudaEvent_t *event, unsigned int flags) {
+    if (!event) {
+        return cudaErrorInvalidValue;
+    }
+    *event = getRuntime().createEvent(flags);
+    return cudaSuccess;
+}
+
+cudaError_t cudaEventDestroy(cudaEvent_t event) {
+    return getRuntime().destroyEvent(event);
+}
+
+cudaError_t cudaEventRecord(cudaEvent_t event, cudaStream_t stream) {
+    return getRuntime().record(event, stream);
+}
+
+cudaError_t cudaEventQuery(cudaEvent_t event) {
+    return getRuntime().queryEvent(event);
+}
+
+cudaError_t cudaEventSynchronize(cudaEvent_t event) {
+    return getRuntime().synchronizeEvent(event);
+}
+
+cudaError_t cudaEventElapsedTime(float *ms, cudaEvent_t start,
+                                 cudaEvent_t end) {
+    if (!ms) {
+        return cudaErrorInvalidValue;
+    }
+    return getRuntime().elapsedTime(ms, start, end);
+}
+
+cudaError_t cudaDeviceSynchronize() {
+    getRuntime().synchronizeDevice();
+    return cudaSuccess;
+}
+
+cudaError_t cudaGetLastError() { return cudaSuccess; }
+
+cudaError_t cudaPeekAtLastError() { return cudaSuccess; }
+
+const char *cudaGetErrorString(cudaError_t error) {
+    switch (error) {
+    case cudaSuccess:
+        return "no error";
+    case cudaErrorInvalidValue:
+        return "invalid argument";
+    case cudaErrorMemoryAllocation:
+        return "out of memory";
+    case cudaErrorInvalidResourceHandle:
+        return "invalid resource handle";
+    case cudaErrorNotReady:
+        return "device not ready";
+    }
+    return "unknown error";
+}
+
+cudaError_t spmdfyEnqueue(cudaStream_t stream, std::function<void()> work) {
+    return getRuntime().enqueue(stream, std::move(work));
+}
@@ -0,0 +1,142 @@
+#include <cuda_runtime.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// the checks of the stream semantics, run with at least two workers so that
+// two streams can make progress at the same time
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << #cond          \
+                      << " failed\n";                                          \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+static void sleepFor(int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+/// \return true if the flag was set before the timeout, a missing ordering
+/// fails the check instead of hanging the test
+static bool waitFor(const std::atomic<int> &flag) {
+    for (int i = 0; i < 5000 && !flag.load(); i++) {
+        sleepFor(1);
+    }
+    return flag.load() != 0;
+}
+
+/// the work of a stream runs in order, the work of two streams concurrently
+static void testTwoStreams() {
+    cudaStream_t s1, s2;
+    CHECK(cudaStreamCreate(&s1) == cudaSuccess);
+    CHECK(cudaStreamCreate(&s2) == cudaSuccess);
+    std::vector<int> order;
+    for (int i = 0; i < 16; i++) {
+        spmdfyEnqueue(s1, [&order, i] { order.push_back(i); });
+    }
+    // s1 waits for s2, which only runs if s2 is not queued behind s1
+    std::atomic<int> flag(0), seen(0);
+    spmdfyEnqueue(s1, [&] { seen = waitFor(flag); });
+    spmdfyEnqueue(s2, [&] { flag = 1; });
+    CHECK(cudaStreamSynchronize(s1) == cudaSuccess);
+    CHECK(seen == 1);
+    CHECK(order.size() == 16);
+    for (size_t i = 0; i < order.size(); i++) {
+        CHECK(order[i] == static_cast<int>(i));
+    }
+    CHECK(cudaStreamDestroy(s1) == cudaSuccess);
+    CHECK(cudaStreamDestroy(s2) == cudaSuccess);
+}
+
+/// the work after cudaStreamWaitEvent runs after the work recorded before
+/// the event on the other stream
+static void testStreamWaitEvent() {
+    cudaStream_t s1, s2;
+    cudaEvent_t event;
+    CHECK(cudaStreamCreate(&s1) == cudaSuccess);
+    CHECK(cudaStreamCreate(&s2) == cudaSuccess);
+    CHECK(cudaEventCreate(&event) == cudaSuccess);
+    std::atomic<int> x(0), y(0);
+    spmdfyEnqueue(s1, [&] {
+        sleepFor(50);
+        x = 1;
+    });
+    CHECK(cudaEventRecord(event, s1) == cudaSuccess);
+    CHECK(cudaStreamWaitEvent(s2, event, 0) == cudaSuccess);
+    spmdfyEnqueue(s2, [&] { y = x.load(); });
+    CHECK(cudaStreamSynchronize(s2) == cudaSuccess);
+    CHECK(y == 1);
+    CHECK(cudaEventQuery(event) == cudaSuccess);
+    CHECK(cudaEventDestroy(event) == cudaSuccess);
+    CHECK(cudaStreamDestroy(s1) == cudaSuccess);
+    CHECK(cudaStreamDestroy(s2) == cudaSuccess);
+}
+
+/// the NULL stream waits for the blocking streams but not for the non
+/// blocking ones
+static void testLegacyStream() {
+    cudaStream_t blocking, non_blocking;
+    CHECK(cudaStreamCreate(&blocking) == cudaSuccess);
+    CHECK(cudaStreamCreateWithFlags(&non_blocking, cudaStreamNonBlocking) ==
+          cudaSuccess);
+    std::atomic<int> a(0), b(0);
+    spmdfyEnqueue(blocking, [&] {
+        sleepFor(50);
+        a = 1;
+    });
+    spmdfyEnqueue(0, [&] { b = a.load(); });
+    CHECK(b == 1);
+
+    // a NULL stream waiting for the non blocking stream would time it out
+    std::atomic<int> flag(0), seen(0);
+    spmdfyEnqueue(non_blocking, [&] { seen = waitFor(flag); });
+    spmdfyEnqueue(0, [&] { flag = 1; });
+    CHECK(cudaStreamSynchronize(non_blocking) == cudaSuccess);
+    CHECK(seen == 1);
+    CHECK(cudaStreamDestroy(blocking) == cudaSuccess);
+    CHECK(cudaStreamDestroy(non_blocking) == cudaSuccess);
+}
+
+/// the elapsed time between two events covers the work between them
+static void testEventElapsedTime() {
+    cudaStream_t stream;
+    cudaEvent_t start, end, untimed;
+    CHECK(cudaStreamCreate(&stream) == cudaSuccess);
+    CHECK(cudaEventCreate(&start) == cudaSuccess);
+    CHECK(cudaEventCreate(&end) == cudaSuccess);
+    CHECK(cudaEventCreateWithFlags(&untimed, cudaEventDisableTiming) ==
+          cudaSuccess);
+    float ms = 0;
+    CHECK(cudaEventElapsedTime(&ms, start, end) ==
+          cudaErrorInvalidResourceHandle);
+    CHECK(cudaEventRecord(start, stream) == cudaSuccess);
+    spmdfyEnqueue(stream, [] { sleepFor(20); });
+    CHECK(cudaEventRecord(end, stream) == cudaSuccess);
+    CHECK(cudaEventRecord(untimed, stream) == cudaSuccess);
+    CHECK(cudaEventSynchronize(end) == cudaSuccess);
+    CHECK(cudaEventElapsedTime(&ms, start, end) == cudaSuccess);
+    CHECK(ms >= 19.0f);
+    CHECK(cudaEventElapsedTime(&ms, start, untimed) ==
+          cudaErrorInvalidResourceHandle);
+    CHECK(cudaEventElapsedTime(nullptr, start, end) == cudaErrorInvalidValue);
+    CHECK(cudaEventDestroy(start) == cudaSuccess);
+    CHECK(cudaEventDestroy(end) == cudaSuccess);
+    CHECK(cudaEventDestroy(untimed) == cudaSuccess);
+    CHECK(cudaStreamDestroy(stream) == cudaSuccess);
+}
+
+int main() {
+    testTwoStreams();
+    testStreamWaitEvent();
+    testLegacyStream();
+    testEventElapsedTime();
+    return failures ? 1 : 0;
+}
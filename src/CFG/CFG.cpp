@@ -1,9 +1,52 @@
 #include <spmdfy/CFG/CFG.hpp>
+#include <spmdfy/CommandLineOpts.hpp>
+
+#include <algorithm>
+#include <cctype>
 
 namespace spmdfy {
 
 namespace cfg {
 
+auto getKernelName(const clang::FunctionDecl *func_decl) -> std::string {
+    std::string name = func_decl->getNameAsString();
+    auto args = func_decl->getTemplateSpecializationArgs();
+    if (!args) {
+        return name;
+    }
+    for (const auto &arg : args->asArray()) {
+        std::string mangled;
+        if (arg.getKind() == clang::TemplateArgument::Type) {
+            mangled = arg.getAsType().getCanonicalType().getAsString();
+        } else if (arg.getKind() == clang::TemplateArgument::Integral) {
+            mangled = arg.getAsIntegral().toString(10);
+            std::replace(mangled.begin(), mangled.end(), '-', 'n');
+        }
+        std::replace_if(mangled.begin(), mangled.end(),
+                        [](char c) { return !std::isalnum(c); }, '_');
+        name += "_" + mangled;
+    }
+    return name;
+}
+
+auto isSoAMarked(const clang::RecordDecl *record_decl) -> bool {
+    for (auto annotate : record_decl->specific_attrs<clang::AnnotateAttr>()) {
+        if (annotate->getAnnotation() == "spmdfy_soa") {
+            return true;
+        }
+    }
+    return std::find(soa_records.begin(), soa_records.end(),
+                     record_decl->getNameAsString()) != soa_records.end();
+}
+
+auto isSoARecord(const clang::RecordDecl *record_decl) -> bool {
+    return isSoAMarked(record_decl) &&
+           std::all_of(record_decl->field_begin(), record_decl->field_end(),
+                       [](const clang::FieldDecl *field) {
+                           return field->getType()->isBuiltinType();
+                       });
+}
+
 auto CFGNode::getNodeTypeName() -> std::string const {
     switch (m_node_type) {
     case Forward:
@@ -78,7 +121,7 @@ auto CFGEdge::setEdgeType(Edge edge_type) -> Edge {
 
 // :CFGEdge
 
-auto CFGNode::getSource() -> std::string const { return m_source; }
+auto CFGNode::getSource() -> llvm::StringRef const { return m_source; }
 auto CFGNode::setSource(const std::string &source) -> std::string {
     return (m_source = source);
 }
@@ -123,13 +166,12 @@ GlobalVarNode::GlobalVarNode(clang::ASTContext &ast_context,
 ForwardNode::ForwardNode() {
     m_node_type = Forward;
     m_name = getNodeTypeName();
-    m_next = new CFGEdge();
 }
 
 auto ForwardNode::splitEdge(BiDirectNode *node) -> BiDirectNode * {
     SPMDFY_INFO("Splitting at {}", getName());
     // 1. Getting current's next
-    auto next = m_next->getTerminal();
+    auto next = m_next.getTerminal();
     if (next == nullptr) {
         SPMDFY_ERROR("[{}] Cannot Split Edge as next node is null",
                      getSource());
@@ -144,7 +186,7 @@ auto ForwardNode::splitEdge(BiDirectNode *node) -> BiDirectNode * {
     node->setNext(next);
 
     // 3. Setting current's to point to node
-    m_next->setTerminal(node);
+    m_next.setTerminal(node);
 
     // 4. Setting back edges
     next->setPrevious(node);
@@ -155,10 +197,10 @@ auto ForwardNode::splitEdge(BiDirectNode *node) -> BiDirectNode * {
     return node;
 }
 
-auto ForwardNode::getNext() -> CFGNode *const { return m_next->getTerminal(); }
+auto ForwardNode::getNext() -> CFGNode *const { return m_next.getTerminal(); }
 
 auto ForwardNode::setNext(CFGNode *node, CFGEdge::Edge edge_type) -> CFGNode * {
-    return m_next->setTerminal(node, edge_type);
+    return m_next.setTerminal(node, edge_type);
 }
 
 // :ForwardNode
@@ -166,34 +208,43 @@ auto ForwardNode::setNext(CFGNode *node, CFGEdge::Edge edge_type) -> CFGNode * {
 BackwardNode::BackwardNode() {
     m_node_type = Backward;
     m_name = getNodeTypeName();
-    m_prev = new CFGEdge();
 }
 
 auto BackwardNode::getPrevious() -> CFGNode *const {
-    return m_prev->getTerminal();
+    return m_prev.getTerminal();
 }
 
 auto BackwardNode::setPrevious(CFGNode *node, CFGEdge::Edge edge_type)
     -> CFGNode * {
-    return m_prev->setTerminal(node, edge_type);
+    return m_prev.setTerminal(node, edge_type);
 }
 
 // :BackwardNode
 
+auto BiDirectNode::getPrevious() -> CFGNode *const {
+    return m_prev.getTerminal();
+}
+
+auto BiDirectNode::setPrevious(CFGNode *node, CFGEdge::Edge edge_type)
+    -> CFGNode * {
+    return m_prev.setTerminal(node, edge_type);
+}
+
+// :BiDirectNode
+
 KernelFuncNode::KernelFuncNode(clang::ASTContext &ast_context,
                                const clang::FunctionDecl *func_decl)
     : m_ast_context(ast_context) {
     SPMDFY_INFO("Creating KerneFuncNode {}", func_decl->getNameAsString());
-    m_name = func_decl->getNameAsString();
+    m_name = getKernelName(func_decl);
     m_source = m_name;
     m_func_decl = func_decl;
     m_node_type = KernelFunc;
     m_context = Global;
-    m_exit = new CFGEdge();
 }
 
 auto KernelFuncNode::getName() -> std::string const {
-    return m_func_decl->getNameAsString();
+    return getKernelName(m_func_decl);
 }
 
 auto KernelFuncNode::getKernelNode() -> const clang::FunctionDecl *const {
@@ -201,11 +252,11 @@ auto KernelFuncNode::getKernelNode() -> const clang::FunctionDecl *const {
 }
 
 auto KernelFuncNode::getExit() -> ExitNode *const {
-    return dynamic_cast<ExitNode *>(m_exit->getTerminal());
+    return llvm::cast_or_null<ExitNode>(m_exit.getTerminal());
 }
 auto KernelFuncNode::setExit(ExitNode *node, CFGEdge::Edge edge_type)
     -> ExitNode * {
-    m_exit->setTerminal(node, edge_type);
+    m_exit.setTerminal(node, edge_type);
     node->setPrevious(this, edge_type);
     return node;
 }
@@ -217,18 +268,16 @@ ConditionalNode::ConditionalNode(clang::ASTContext &ast_context,
     : m_ast_context(ast_context) {
     m_node_type = Conditional;
     m_name = getNodeTypeName();
-    true_b = m_next;
-    reconv = new CFGEdge();
     m_cond_stmt = stmt;
 }
 
 auto ConditionalNode::getReconv() -> CFGNode *const {
-    return reconv->getTerminal();
+    return m_reconv.getTerminal();
 }
 
 auto ConditionalNode::setReconv(CFGNode *node, CFGEdge::Edge edge_type)
     -> CFGNode * {
-    return reconv->setTerminal(node, edge_type);
+    return m_reconv.setTerminal(node, edge_type);
 }
 
 // :ConditionalNode
@@ -238,7 +287,6 @@ IfStmtNode::IfStmtNode(clang::ASTContext &ast_context,
     : ConditionalNode(ast_context, if_stmt) {
     m_node_type = IfStmt;
     m_name = getNodeTypeName();
-    false_b = new CFGEdge();
     m_source =
         "if (" +
         sourceDump(ast_context.getSourceManager(), ast_context.getLangOpts(),
@@ -254,7 +302,7 @@ auto IfStmtNode::splitTrueEdge(BiDirectNode *node) -> BiDirectNode * {
 
 auto IfStmtNode::splitFalseEdge(BiDirectNode *node) -> BiDirectNode * {
     SPMDFY_INFO("Splitting False Edge");
-    auto next = false_b->getTerminal();
+    auto next = m_false.getTerminal();
     if (next == nullptr) {
         SPMDFY_ERROR("[{}] Cannot Split Edge as next node is null",
                      getSource());
@@ -264,7 +312,7 @@ auto IfStmtNode::splitFalseEdge(BiDirectNode *node) -> BiDirectNode * {
     SPMDFY_INFO("{} -> {}", "IfStmtNode", next->getSource());
     SPMDFY_INFO("to:");
     node->setNext(next, cfg::CFGEdge::Complete);
-    false_b->setTerminal(node, cfg::CFGEdge::Complete);
+    m_false.setTerminal(node, cfg::CFGEdge::Complete);
     next->setPrevious(node, cfg::CFGEdge::Complete);
     node->setPrevious(this, cfg::CFGEdge::Complete);
     SPMDFY_INFO("{} -> {} -> {}", node->getPrevious()->getSource(),
@@ -273,19 +321,19 @@ auto IfStmtNode::splitFalseEdge(BiDirectNode *node) -> BiDirectNode * {
 }
 
 auto IfStmtNode::getTrueBlock() -> CFGNode *const {
-    return true_b->getTerminal();
+    return m_next.getTerminal();
 }
 auto IfStmtNode::getFalseBlock() -> CFGNode *const {
-    return false_b->getTerminal();
+    return m_false.getTerminal();
 }
 
 auto IfStmtNode::setTrueBlock(CFGNode *node, CFGEdge::Edge edge_type)
     -> CFGNode * {
-    return true_b->setTerminal(node, edge_type);
+    return m_next.setTerminal(node, edge_type);
 }
 auto IfStmtNode::setFalseBlock(CFGNode *node, CFGEdge::Edge edge_type)
     -> CFGNode * {
-    return false_b->setTerminal(node, edge_type);
+    return m_false.setTerminal(node, edge_type);
 }
 
 // :IfStmtNode
@@ -307,8 +355,7 @@ ReconvNode::ReconvNode(ConditionalNode *cond_node) {
     m_name = getNodeTypeName();
     m_source = std::string();
     m_context = Kernel;
-    back = m_prev;
-    back->setTerminal(cond_node);
+    m_prev.setTerminal(cond_node);
 }
 
 auto ReconvNode::setPrevious(CFGNode *node, CFGEdge::Edge edge_type)
@@ -317,10 +364,10 @@ auto ReconvNode::setPrevious(CFGNode *node, CFGEdge::Edge edge_type)
 }
 
 auto ReconvNode::setBack(CFGNode *node, CFGEdge::Edge edge_type) -> CFGNode * {
-    return back->setTerminal(node, edge_type);
+    return m_prev.setTerminal(node, edge_type);
 }
 
-auto ReconvNode::getBack() -> CFGNode *const { return back->getTerminal(); }
+auto ReconvNode::getBack() -> CFGNode *const { return m_prev.getTerminal(); }
 
 // :ReconvNode
 
@@ -343,30 +390,34 @@ auto InternalNode::getInternalNodeName() -> std::string const {
 
 auto InternalNode::getInternalNode() -> InternalNodeTy const { return m_node; }
 
-auto InternalNode::getSource() -> std::string const {
+auto InternalNode::getSource() -> llvm::StringRef const {
     auto &m_sm = m_ast_context.getSourceManager();
     auto m_lang_opts = m_ast_context.getLangOpts();
     m_lang_opts.CPlusPlus = true;
     m_lang_opts.Bool = true;
     return std::visit(
-        Overload{[](const clang::Decl *decl) -> std::string {
-                     if (llvm::isa<const clang::NamedDecl>(decl)) {
-                         return llvm::cast<const clang::NamedDecl>(decl)
-                             ->getNameAsString();
+        Overload{[](const clang::Decl *decl) -> llvm::StringRef {
+                     auto named_decl = llvm::dyn_cast<clang::NamedDecl>(decl);
+                     if (named_decl && named_decl->getIdentifier()) {
+                         return named_decl->getName();
                      }
                      return "";
                  },
-                 [&m_sm, &m_lang_opts](const clang::Stmt *stmt) -> std::string {
-                     return SRCDUMP(stmt);
+                 [&m_sm,
+                  &m_lang_opts](const clang::Stmt *stmt) -> llvm::StringRef {
+                     return SRCSLICE(stmt);
                  },
-                 [&m_sm, &m_lang_opts](const clang::Expr *expr) -> std::string {
-                     return SRCDUMP(expr);
+                 [&m_sm,
+                  &m_lang_opts](const clang::Expr *expr) -> llvm::StringRef {
+                     return SRCSLICE(expr);
                  },
-                 [&m_lang_opts](const clang::Type *type) -> std::string {
+                 // the printed type is kept alive by the node
+                 [this, &m_lang_opts](const clang::Type *type)
+                     -> llvm::StringRef {
                      clang::PrintingPolicy pm(m_lang_opts);
                      clang::QualType qual =
                          clang::QualType::getFromOpaquePtr(type);
-                     return qual.getAsString(pm);
+                     return m_source = qual.getAsString(pm);
                  }},
         m_node);
 }
@@ -16,7 +16,44 @@ const std::map<std::string, std::string> g_SpmdfyTypeMap = {
     {"uint64_t", "unsigned int64"},
     {"short", "int16"},
     {"unsigned short", "unsigned int16"},
-    {"_Bool", "bool"}};
+    {"_Bool", "bool"},
+    // CUDA vector types are ISPC short vectors
+    {"char2", "int8<2>"},
+    {"char3", "int8<3>"},
+    {"char4", "int8<4>"},
+    {"uchar2", "unsigned int8<2>"},
+    {"uchar3", "unsigned int8<3>"},
+    {"uchar4", "unsigned int8<4>"},
+    {"short2", "int16<2>"},
+    {"short3", "int16<3>"},
+    {"short4", "int16<4>"},
+    {"ushort2", "unsigned int16<2>"},
+    {"ushort3", "unsigned int16<3>"},
+    {"ushort4", "unsigned int16<4>"},
+    {"int2", "int32<2>"},
+    {"int3", "int32<3>"},
+    {"int4", "int32<4>"},
+    {"uint2", "unsigned int32<2>"},
+    {"uint3", "unsigned int32<3>"},
+    {"uint4", "unsigned int32<4>"},
+    {"long2", "int64<2>"},
+    {"long3", "int64<3>"},
+    {"long4", "int64<4>"},
+    {"ulong2", "unsigned int64<2>"},
+    {"ulong3", "unsigned int64<3>"},
+    {"ulong4", "unsigned int64<4>"},
+    {"longlong2", "int64<2>"},
+    {"longlong3", "int64<3>"},
+    {"longlong4", "int64<4>"},
+    {"ulonglong2", "unsigned int64<2>"},
+    {"ulonglong3", "unsigned int64<3>"},
+    {"ulonglong4", "unsigned int64<4>"},
+    {"float2", "float<2>"},
+    {"float3", "float<3>"},
+    {"float4", "float<4>"},
+    {"double2", "double<2>"},
+    {"double3", "double<3>"},
+    {"double4", "double<4>"}};
 
 const std::map<std::string, std::string> g_SpmdfyAtomicMap = {
     {"atomicAdd", "atomic_add_global"},
@@ -24,43 +61,146 @@ const std::map<std::string, std::string> g_SpmdfyAtomicMap = {
     {"atomicExch", "atomic_swap_global"},
     {"atomicMin", "atomic_min_global"},
     {"atomicMax", "atomic_max_global"},
-    {"atomicCAS", "atomic_compare_exchange"}};
+    {"atomicCAS", "atomic_compare_exchange_global"}};
 
-const std::map<std::string, std::pair<bool, std::string>>
-    g_SpmdfyMathInstrinsicsMap = {{"aconf", {1, "acosf"}},
-                                  {"acoshf", {0, R"begin(
-    )begin"}},
-                                  {"asinf", {1, "asin"}},
-                                  {"asinhf", {0, R"begin(
-        float asinhf(float x){
-            return (exp(x) - exp(-x)) / 2;
-        }
-    )begin"}},
-                                  {"atan2f", {1, "atan2"}},
-                                  {"atanf", {1, "atan"}},
-                                  {"atanhf", {0, R"begin(
-        float atanhf(float x){
-            return ((exp(x) - exp(-x)) / (exp(x) + exp(-x)));
-        }
-    )begin"}},
-                                  {"cbrtf", {0, R"begin()begin"}},
-                                  {"ceilf", {1, "ceil"}},
-                                  {"copysignf", {0, R"begin(
-        float copysignf(float x, float y){
-            return x * (y < 0 ? -1 : 1);
-        }
-    )begin"}},
-                                  {"cosf", {1, "cos"}},
-                                  {"coshf", {0, R"begin(
-        float coshf(float x){
-            return (exp(x) + exp(-x)) / 2;
-        }
-    )begin"}},
-                                  {"__expf", {1, "exp"}},
-                                  {"__logf", {1, "log"}},
-                                  {"sqrtf", {1, "sqrt"}},
-                                  {"__ffs", {0, R"begin(
-        int __ffs(int i) {
-            return ((i != 0) ? count_trailing_zeros(i) + 1 : 0);
-        }
-                                  )begin"}}};
\ No newline at end of file
+const std::map<std::string, std::string> g_SpmdfyAtomicReduceMap = {
+    {"atomicAdd", "reduce_add"},
+    {"atomicSub", "reduce_add"},
+    {"atomicMin", "reduce_min"},
+    {"atomicMax", "reduce_max"}};
+
+const std::map<std::string, std::string> g_SpmdfyWarpMap = {
+    {"__shfl_sync", "__spmdfy_shfl"},
+    {"__shfl_up_sync", "__spmdfy_shfl_up"},
+    {"__shfl_down_sync", "__spmdfy_shfl_down"},
+    {"__shfl_xor_sync", "__spmdfy_shfl_xor"},
+    {"__ballot_sync", "packmask"},
+    {"__any_sync", "any"},
+    {"__all_sync", "all"},
+    {"__popc", "popcnt"},
+    {"__popcll", "popcnt"},
+    {"__activemask", "lanemask"}};
+
+const std::map<std::string, std::pair<std::string, std::string>>
+    g_SpmdfyMathInstrinsicsMap = {
+    {"__cosf", {"cos", "cos"}},
+    {"__exp10f", {"__spmdfy_exp10", "__spmdfy_exp10"}},
+    {"__expf", {"exp", "exp"}},
+    {"__fdividef", {"__spmdfy_fdivide", "__spmdfy_fdivide"}},
+    {"__ffs", {"__spmdfy_ffs", "__spmdfy_ffs"}},
+    {"__ffsll", {"__spmdfy_ffs", "__spmdfy_ffs"}},
+    {"__frcp_rn", {"__spmdfy_rcp", "rcp"}},
+    {"__frsqrt_rn", {"__spmdfy_rsqrt", "rsqrt"}},
+    {"__fsqrt_rn", {"sqrt", "sqrt"}},
+    {"__log10f", {"__spmdfy_log10", "__spmdfy_log10"}},
+    {"__log2f", {"__spmdfy_log2", "__spmdfy_log2"}},
+    {"__logf", {"log", "log"}},
+    {"__powf", {"pow", "pow"}},
+    {"__saturatef", {"__spmdfy_saturate", "__spmdfy_saturate"}},
+    {"__sincosf", {"sincos", "sincos"}},
+    {"__sinf", {"sin", "sin"}},
+    {"__tanf", {"tan", "tan"}},
+    {"acos", {"acos", "acos"}},
+    {"acosf", {"acos", "acos"}},
+    {"acosh", {"__spmdfy_acosh", "__spmdfy_acosh_fast"}},
+    {"acoshf", {"__spmdfy_acosh", "__spmdfy_acosh_fast"}},
+    {"asin", {"asin", "asin"}},
+    {"asinf", {"asin", "asin"}},
+    {"asinh", {"__spmdfy_asinh", "__spmdfy_asinh_fast"}},
+    {"asinhf", {"__spmdfy_asinh", "__spmdfy_asinh_fast"}},
+    {"atan", {"atan", "atan"}},
+    {"atan2", {"atan2", "atan2"}},
+    {"atan2f", {"atan2", "atan2"}},
+    {"atanf", {"atan", "atan"}},
+    {"atanh", {"__spmdfy_atanh", "__spmdfy_atanh_fast"}},
+    {"atanhf", {"__spmdfy_atanh", "__spmdfy_atanh_fast"}},
+    {"cbrt", {"__spmdfy_cbrt", "__spmdfy_cbrt_fast"}},
+    {"cbrtf", {"__spmdfy_cbrt", "__spmdfy_cbrt_fast"}},
+    {"ceil", {"ceil", "ceil"}},
+    {"ceilf", {"ceil", "ceil"}},
+    {"copysign", {"__spmdfy_copysign", "__spmdfy_copysign"}},
+    {"copysignf", {"__spmdfy_copysign", "__spmdfy_copysign"}},
+    {"cos", {"cos", "cos"}},
+    {"cosf", {"cos", "cos"}},
+    {"cosh", {"__spmdfy_cosh", "__spmdfy_cosh"}},
+    {"coshf", {"__spmdfy_cosh", "__spmdfy_cosh"}},
+    {"cospi", {"__spmdfy_cospi", "__spmdfy_cospi"}},
+    {"cospif", {"__spmdfy_cospi", "__spmdfy_cospi"}},
+    {"erf", {"__spmdfy_erf", "__spmdfy_erf"}},
+    {"erfc", {"__spmdfy_erfc", "__spmdfy_erfc"}},
+    {"erfcf", {"__spmdfy_erfc", "__spmdfy_erfc"}},
+    {"erff", {"__spmdfy_erf", "__spmdfy_erf"}},
+    {"exp", {"exp", "exp"}},
+    {"exp10", {"__spmdfy_exp10", "__spmdfy_exp10"}},
+    {"exp10f", {"__spmdfy_exp10", "__spmdfy_exp10"}},
+    {"exp2", {"__spmdfy_exp2", "__spmdfy_exp2"}},
+    {"exp2f", {"__spmdfy_exp2", "__spmdfy_exp2"}},
+    {"expf", {"exp", "exp"}},
+    {"expm1", {"__spmdfy_expm1", "__spmdfy_expm1_fast"}},
+    {"expm1f", {"__spmdfy_expm1", "__spmdfy_expm1_fast"}},
+    {"fabs", {"abs", "abs"}},
+    {"fabsf", {"abs", "abs"}},
+    {"fdim", {"__spmdfy_fdim", "__spmdfy_fdim"}},
+    {"fdimf", {"__spmdfy_fdim", "__spmdfy_fdim"}},
+    {"floor", {"floor", "floor"}},
+    {"floorf", {"floor", "floor"}},
+    {"fma", {"__spmdfy_fma", "__spmdfy_fma"}},
+    {"fmaf", {"__spmdfy_fma", "__spmdfy_fma"}},
+    {"fmax", {"max", "max"}},
+    {"fmaxf", {"max", "max"}},
+    {"fmin", {"min", "min"}},
+    {"fminf", {"min", "min"}},
+    {"fmod", {"__spmdfy_fmod", "__spmdfy_fmod"}},
+    {"fmodf", {"__spmdfy_fmod", "__spmdfy_fmod"}},
+    {"frexp", {"frexp", "frexp"}},
+    {"frexpf", {"frexp", "frexp"}},
+    {"hypot", {"__spmdfy_hypot", "__spmdfy_hypot_fast"}},
+    {"hypotf", {"__spmdfy_hypot", "__spmdfy_hypot_fast"}},
+    {"ldexp", {"ldexp", "ldexp"}},
+    {"ldexpf", {"ldexp", "ldexp"}},
+    {"llrint", {"__spmdfy_lrint", "__spmdfy_lrint"}},
+    {"llrintf", {"__spmdfy_lrint", "__spmdfy_lrint"}},
+    {"llround", {"__spmdfy_lround", "__spmdfy_lround"}},
+    {"llroundf", {"__spmdfy_lround", "__spmdfy_lround"}},
+    {"log", {"log", "log"}},
+    {"log10", {"__spmdfy_log10", "__spmdfy_log10"}},
+    {"log10f", {"__spmdfy_log10", "__spmdfy_log10"}},
+    {"log1p", {"__spmdfy_log1p", "__spmdfy_log1p_fast"}},
+    {"log1pf", {"__spmdfy_log1p", "__spmdfy_log1p_fast"}},
+    {"log2", {"__spmdfy_log2", "__spmdfy_log2"}},
+    {"log2f", {"__spmdfy_log2", "__spmdfy_log2"}},
+    {"logf", {"log", "log"}},
+    {"lrint", {"__spmdfy_lrint", "__spmdfy_lrint"}},
+    {"lrintf", {"__spmdfy_lrint", "__spmdfy_lrint"}},
+    {"lround", {"__spmdfy_lround", "__spmdfy_lround"}},
+    {"lroundf", {"__spmdfy_lround", "__spmdfy_lround"}},
+    {"nearbyint", {"round", "round"}},
+    {"nearbyintf", {"round", "round"}},
+    {"normcdf", {"__spmdfy_normcdf", "__spmdfy_normcdf"}},
+    {"normcdff", {"__spmdfy_normcdf", "__spmdfy_normcdf"}},
+    {"pow", {"pow", "pow"}},
+    {"powf", {"pow", "pow"}},
+    {"rcbrt", {"__spmdfy_rcbrt", "__spmdfy_rcbrt_fast"}},
+    {"rcbrtf", {"__spmdfy_rcbrt", "__spmdfy_rcbrt_fast"}},
+    {"rint", {"round", "round"}},
+    {"rintf", {"round", "round"}},
+    {"round", {"__spmdfy_round", "__spmdfy_round"}},
+    {"roundf", {"__spmdfy_round", "__spmdfy_round"}},
+    {"rsqrt", {"__spmdfy_rsqrt", "rsqrt"}},
+    {"rsqrtf", {"__spmdfy_rsqrt", "rsqrt"}},
+    {"sin", {"sin", "sin"}},
+    {"sincos", {"sincos", "sincos"}},
+    {"sincosf", {"sincos", "sincos"}},
+    {"sinf", {"sin", "sin"}},
+    {"sinh", {"__spmdfy_sinh", "__spmdfy_sinh_fast"}},
+    {"sinhf", {"__spmdfy_sinh", "__spmdfy_sinh_fast"}},
+    {"sinpi", {"__spmdfy_sinpi", "__spmdfy_sinpi"}},
+    {"sinpif", {"__spmdfy_sinpi", "__spmdfy_sinpi"}},
+    {"sqrt", {"sqrt", "sqrt"}},
+    {"sqrtf", {"sqrt", "sqrt"}},
+    {"tan", {"tan", "tan"}},
+    {"tanf", {"tan", "tan"}},
+    {"tanh", {"__spmdfy_tanh", "__spmdfy_tanh_fast"}},
+    {"tanhf", {"__spmdfy_tanh", "__spmdfy_tanh_fast"}},
+    {"trunc", {"__spmdfy_trunc", "__spmdfy_trunc"}},
+    {"truncf", {"__spmdfy_trunc", "__spmdfy_trunc"}}};
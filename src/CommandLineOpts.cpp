@@ -25,4 +25,110 @@ llvm::cl::opt<std::string> generate_ispc_macros(
 llvm::cl::opt<bool>
     generate_decl("fgenerate-decls",
                   llvm::cl::desc("Generate only ISPC declarations"),
-                  llvm::cl::cat(spmdfy_options));
\ No newline at end of file
+                  llvm::cl::cat(spmdfy_options));
+
+llvm::cl::opt<bool> ispc_tasks(
+    "fispc-tasks",
+    llvm::cl::desc("Map CUDA grid blocks onto ISPC tasks so that a kernel is "
+                   "launched across all the cores"),
+    llvm::cl::cat(spmdfy_options));
+
+llvm::cl::opt<bool> no_warp_block(
+    "fno-warp-block",
+    llvm::cl::desc("Do not generate the specialized path for blocks of "
+                   "exactly one gang(blockDim == {programCount, 1, 1})"),
+    llvm::cl::cat(spmdfy_options));
+
+llvm::cl::opt<unsigned>
+    jobs("j",
+         llvm::cl::desc("Number of sources to spmdfy in parallel(default: "
+                        "number of hardware threads)"),
+         llvm::cl::value_desc("N"), llvm::cl::init(0),
+         llvm::cl::cat(spmdfy_options));
+
+llvm::cl::opt<std::string> cache_dir(
+    "cache-dir",
+    llvm::cl::desc("Reuse the ISPC source cached in the directory when the "
+                   "preprocessed source and the options are unchanged"),
+    llvm::cl::value_desc("directory"), llvm::cl::cat(spmdfy_options));
+
+llvm::cl::opt<bool> generate_depfile(
+    "MD",
+    llvm::cl::desc("Write a Makefile/Ninja depfile listing the headers of "
+                   "the source to <output>.d"),
+    llvm::cl::cat(spmdfy_options));
+
+llvm::cl::opt<std::string>
+    depfile("MF",
+            llvm::cl::desc("Write the depfile to filename instead(implies "
+                           "-MD, only for a single source)"),
+            llvm::cl::value_desc("filename"), llvm::cl::cat(spmdfy_options));
+
+llvm::cl::opt<std::string> pch_cache_dir(
+    "pch-cache",
+    llvm::cl::desc("Precompile the CUDA wrapper and runtime headers into the "
+                   "directory once and load them on later invocations"),
+    llvm::cl::value_desc("directory"), llvm::cl::cat(spmdfy_options));
+
+llvm::cl::opt<FormatMode> format_mode(
+    "format", llvm::cl::desc("Format the generated ISPC:"),
+    llvm::cl::values(
+        clEnumValN(FormatMode::None, "none",
+                   "only indent the code while generating it"),
+        clEnumValN(FormatMode::Fast, "fast",
+                   "clang-format with the LLVM style, without sorting "
+                   "includes or breaking lines"),
+        clEnumValN(FormatMode::Clang, "clang",
+                   "clang-format with the style of the .clang-format of the "
+                   "output(default)")),
+    llvm::cl::init(FormatMode::Clang), llvm::cl::cat(spmdfy_options));
+
+llvm::cl::opt<bool> group_atomics(
+    "fgroup-atomics",
+    llvm::cl::desc("Issue one atomic per distinct index of the gang for "
+                   "atomics on a varying element of a uniform array"),
+    llvm::cl::cat(spmdfy_options));
+
+llvm::cl::opt<bool> fast_math(
+    "fast-math",
+    llvm::cl::desc("Lower the CUDA math functions to their fast "
+                   "approximations, see docs/math.rst"),
+    llvm::cl::cat(spmdfy_options));
+
+llvm::cl::list<std::string> soa_records(
+    "soa",
+    llvm::cl::desc("Lay out the arrays of the structs passed to kernels as "
+                   "ISPC soa<> arrays, like structs annotated with "
+                   "__attribute__((annotate(\"spmdfy_soa\")))"),
+    llvm::cl::value_desc("struct,..."), llvm::cl::CommaSeparated,
+    llvm::cl::cat(spmdfy_options));
+
+llvm::cl::opt<unsigned> soa_width(
+    "soa-width",
+    llvm::cl::desc("Number of structs in a block of the soa<> arrays, a "
+                   "power of two(default: 8)"),
+    llvm::cl::value_desc("N"), llvm::cl::init(8),
+    llvm::cl::cat(spmdfy_options));
+
+llvm::cl::list<unsigned> block_dim(
+    "block-dim",
+    llvm::cl::desc("Specialize the kernels for blocks of this size, the "
+                   "kernels fall back to the generic code for other sizes. "
+                   "Without it, kernels with __launch_bounds__(N) are "
+                   "specialized for {N, 1, 1}"),
+    llvm::cl::value_desc("X,Y,Z"), llvm::cl::CommaSeparated,
+    llvm::cl::cat(spmdfy_options));
+
+llvm::cl::opt<std::string> host_output(
+    "host-output",
+    llvm::cl::desc("Write the host code with the kernel launches rewritten "
+                   "into calls of the ISPC kernels to filename(a directory "
+                   "for multiple sources)"),
+    llvm::cl::value_desc("filename"), llvm::cl::cat(spmdfy_options));
+
+llvm::cl::list<std::string> host_includes(
+    "host-include",
+    llvm::cl::desc("Include the headers, e.g. the header ISPC generates for "
+                   "the kernels, at the top of the host code"),
+    llvm::cl::value_desc("header,..."), llvm::cl::CommaSeparated,
+    llvm::cl::cat(spmdfy_options));
@@ -0,0 +1,93 @@
+#include <spmdfy/FileCache.hpp>
+#include <spmdfy/Logger.hpp>
+
+namespace spmdfy {
+
+auto FileCache::status(const std::string &path, llvm::vfs::FileSystem &fs)
+    -> llvm::ErrorOr<llvm::vfs::Status> {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto cached = m_status.find(path);
+    if (cached == m_status.end()) {
+        cached = m_status.emplace(path, fs.status(path)).first;
+    }
+    return cached->second;
+}
+
+auto FileCache::buffer(const std::string &path, llvm::vfs::FileSystem &fs)
+    -> llvm::ErrorOr<const llvm::MemoryBuffer *> {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto cached = m_buffers.find(path);
+    if (cached == m_buffers.end()) {
+        auto buffer = fs.getBufferForFile(path);
+        if (!buffer) {
+            return buffer.getError();
+        }
+        SPMDFY_INFO("Caching file {}", path);
+        cached = m_buffers.emplace(path, std::move(*buffer)).first;
+    }
+    return cached->second.get();
+}
+
+/// A read only file backed by a buffer in the FileCache
+class CachedFile : public llvm::vfs::File {
+  public:
+    CachedFile(llvm::vfs::Status status, const llvm::MemoryBuffer *buffer)
+        : m_status(std::move(status)), m_buffer(buffer) {}
+
+    auto status() -> llvm::ErrorOr<llvm::vfs::Status> override {
+        return m_status;
+    }
+
+    auto getBuffer(const llvm::Twine &name, int64_t file_size,
+                   bool requires_null_terminator, bool is_volatile)
+        -> llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> override {
+        return llvm::MemoryBuffer::getMemBuffer(
+            m_buffer->getBuffer(), name.str(), requires_null_terminator);
+    }
+
+    auto close() -> std::error_code override { return std::error_code(); }
+
+  private:
+    llvm::vfs::Status m_status;
+    const llvm::MemoryBuffer *m_buffer;
+};
+
+CachedFileSystem::CachedFileSystem(FileCache &cache)
+    : llvm::vfs::ProxyFileSystem(
+          llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>(
+              llvm::vfs::createPhysicalFileSystem().release())),
+      m_cache(cache) {}
+
+auto CachedFileSystem::status(const llvm::Twine &path)
+    -> llvm::ErrorOr<llvm::vfs::Status> {
+    llvm::SmallString<256> abs_path;
+    path.toVector(abs_path);
+    if (auto error_code = makeAbsolute(abs_path)) {
+        return error_code;
+    }
+    auto status = m_cache.status(abs_path.str(), getUnderlyingFS());
+    if (!status) {
+        return status;
+    }
+    return llvm::vfs::Status::copyWithNewName(*status, path);
+}
+
+auto CachedFileSystem::openFileForRead(const llvm::Twine &path)
+    -> llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> {
+    llvm::SmallString<256> abs_path;
+    path.toVector(abs_path);
+    if (auto error_code = makeAbsolute(abs_path)) {
+        return error_code;
+    }
+    auto status = this->status(path);
+    if (!status) {
+        return status.getError();
+    }
+    auto buffer = m_cache.buffer(abs_path.str(), getUnderlyingFS());
+    if (!buffer) {
+        return buffer.getError();
+    }
+    return std::unique_ptr<llvm::vfs::File>(new CachedFile(*status, *buffer));
+}
+
+} // namespace spmdfy
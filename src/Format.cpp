@@ -1,98 +1,129 @@
 #include <spmdfy/Format.hpp>
 
+#include <algorithm>
+#include <cctype>
+
 namespace spmdfy {
 namespace format {
 
-static clang::FileID createInMemoryFile(StringRef FileName,
-                                        MemoryBuffer *Source,
-                                        clang::SourceManager &Sources,
-                                        clang::FileManager &Files,
-                                        llvm::vfs::InMemoryFileSystem *MemFS) {
-    MemFS->addFileNoOwn(FileName, 0, Source);
-    return Sources.createFileID(Files.getFile(FileName),
-                                clang::SourceLocation(), clang::SrcMgr::C_User);
+bool format(StringRef FileName, std::string &Code, FormatMode Mode) {
+    if (Code.empty()) {
+        return false; // Empty files are formatted correctly.
+    }
+    std::vector<clang::tooling::Range> Ranges = {
+        clang::tooling::Range(0, Code.size())};
+    clang::format::FormatStyle Style = clang::format::getLLVMStyle();
+    if (Mode == FormatMode::Fast) {
+        // no .clang-format lookup, include sorting or line breaking
+        Style.ColumnLimit = 0;
+    } else {
+        llvm::Expected<clang::format::FormatStyle> FormatStyle =
+            clang::format::getStyle( //"{BasedOnStyle: llvm, IndentWidth: 4}",
+                clang::format::DefaultFormatStyle, FileName,
+                clang::format::DefaultFallbackStyle, Code);
+        if (!FormatStyle) {
+            llvm::errs() << llvm::toString(FormatStyle.takeError()) << "\n";
+            return true;
+        }
+        Style = *FormatStyle;
+        unsigned CursorPosition = 0;
+        Replacements Replaces =
+            sortIncludes(Style, Code, Ranges, FileName, &CursorPosition);
+        auto ChangedCode = clang::tooling::applyAllReplacements(Code, Replaces);
+        if (!ChangedCode) {
+            llvm::errs() << llvm::toString(ChangedCode.takeError()) << "\n";
+            return true;
+        }
+        Code = std::move(*ChangedCode);
+        // Get new affected ranges after sorting `#includes`.
+        Ranges =
+            clang::tooling::calculateRangesAfterReplacements(Replaces, Ranges);
+    }
+    clang::format::FormattingAttemptStatus Status;
+    Replacements FormatChanges =
+        reformat(Style, Code, Ranges, FileName, &Status);
+    auto FormattedCode =
+        clang::tooling::applyAllReplacements(Code, FormatChanges);
+    if (!FormattedCode) {
+        llvm::errs() << llvm::toString(FormattedCode.takeError()) << "\n";
+        return true;
+    }
+    Code = std::move(*FormattedCode);
+    return false;
 }
 
-static bool parseLineRange(StringRef Input, unsigned &FromLine,
-                           unsigned &ToLine) {
-    std::pair<StringRef, StringRef> LineRange = Input.split(':');
-    return LineRange.first.getAsInteger(0, FromLine) ||
-           LineRange.second.getAsInteger(0, ToLine);
+IndentingOStream::~IndentingOStream() {
+    flush();
+    if (!m_line.empty()) {
+        writeLine(false);
+    }
 }
 
-static bool fillRanges(MemoryBuffer *Code,
-                       std::vector<clang::tooling::Range> &Ranges) {
-    IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> InMemoryFileSystem(
-        new llvm::vfs::InMemoryFileSystem);
-    clang::FileManager Files(clang::FileSystemOptions(), InMemoryFileSystem);
-    clang::DiagnosticsEngine Diagnostics(
-        IntrusiveRefCntPtr<clang::DiagnosticIDs>(new clang::DiagnosticIDs),
-        new clang::DiagnosticOptions);
-    clang::SourceManager Sources(Diagnostics, Files);
-    clang::FileID ID = createInMemoryFile("<irrelevant>", Code, Sources, Files,
-                                          InMemoryFileSystem.get());
-    clang::SourceLocation Start =
-        Sources.getLocForStartOfFile(ID).getLocWithOffset(0);
-    clang::SourceLocation End;
-    End = Sources.getLocForEndOfFile(ID);
-    unsigned Offset = Sources.getFileOffset(Start);
-    unsigned Length = Sources.getFileOffset(End) - Offset;
-    Ranges.push_back(clang::tooling::Range(Offset, Length));
-    return false;
+void IndentingOStream::write_impl(const char *Ptr, size_t Size) {
+    m_pos += Size;
+    for (StringRef Rest(Ptr, Size); !Rest.empty();) {
+        std::pair<StringRef, StringRef> Line = Rest.split('\n');
+        m_line.append(Line.first.begin(), Line.first.end());
+        if (Line.first.size() == Rest.size()) {
+            break;
+        }
+        writeLine(true);
+        Rest = Line.second;
+    }
 }
 
-bool format(StringRef FileName) {
-    ErrorOr<std::unique_ptr<MemoryBuffer>> CodeOrErr =
-        MemoryBuffer::getFileAsStream(FileName);
-    if (std::error_code EC = CodeOrErr.getError()) {
-        errs() << EC.message() << "\n";
-        return true;
+/// \return the change of the nesting depth by the braces of the line and the
+/// ISPC_*_START/ISPC_*_END macros, which open and close a block themselves
+static int getDepthChange(StringRef Line, bool &StartsWithClose) {
+    int Change = 0;
+    StartsWithClose = false;
+    char Quote = 0;
+    for (size_t I = 0; I < Line.size(); I++) {
+        char C = Line[I];
+        if (Quote) {
+            if (C == '\\') {
+                I++;
+            } else if (C == Quote) {
+                Quote = 0;
+            }
+            continue;
+        }
+        if (C == '"' || C == '\'') {
+            Quote = C;
+        } else if (Line.substr(I).startswith("//")) {
+            break;
+        } else if (C == '{') {
+            Change++;
+        } else if (C == '}') {
+            StartsWithClose |= Change == 0 && I == 0;
+            Change--;
+        }
     }
-    std::unique_ptr<llvm::MemoryBuffer> Code = std::move(CodeOrErr.get());
-    if (Code->getBufferSize() == 0) {
-        errs() << "File is empty?\n";
-        return false; // Empty files are formatted correctly.
+    StringRef Macro = Line.take_while(
+        [](char C) { return std::isalnum(C) || C == '_'; });
+    if (Macro.startswith("ISPC_") && Macro.endswith("_START")) {
+        Change++;
+    } else if (Macro.startswith("ISPC_") && Macro.endswith("_END")) {
+        StartsWithClose = true;
+        Change--;
     }
-    std::vector<clang::tooling::Range> Ranges;
-    if (fillRanges(Code.get(), Ranges))
-        return true;
-    llvm::Expected<clang::format::FormatStyle> FormatStyle =
-        clang::format::getStyle( //"{BasedOnStyle: llvm, IndentWidth: 4}",
-            clang::format::DefaultFormatStyle, FileName,
-            clang::format::DefaultFallbackStyle, Code->getBuffer());
-    if (!FormatStyle) {
-        llvm::errs() << llvm::toString(FormatStyle.takeError()) << "\n";
-        return true;
+    return Change;
+}
+
+void IndentingOStream::writeLine(bool Newline) {
+    StringRef Line = StringRef(m_line).trim();
+    if (!Line.empty()) {
+        bool StartsWithClose;
+        int Change = getDepthChange(Line, StartsWithClose);
+        int Depth = std::max(m_depth - (StartsWithClose ? 1 : 0), 0);
+        m_out.indent(Depth * m_indent_width) << Line;
+        m_depth = std::max(m_depth + Change, 0);
     }
-    unsigned CursorPosition = 0;
-    Replacements Replaces = sortIncludes(*FormatStyle, Code->getBuffer(),
-                                         Ranges, FileName, &CursorPosition);
-    auto ChangedCode =
-        clang::tooling::applyAllReplacements(Code->getBuffer(), Replaces);
-    if (!ChangedCode) {
-        llvm::errs() << llvm::toString(ChangedCode.takeError()) << "\n";
-        return true;
+    if (Newline) {
+        m_out << "\n";
     }
-    // Get new affected ranges after sorting `#includes`.
-    Ranges = clang::tooling::calculateRangesAfterReplacements(Replaces, Ranges);
-    clang::format::FormattingAttemptStatus Status;
-    Replacements FormatChanges =
-        reformat(*FormatStyle, *ChangedCode, Ranges, FileName, &Status);
-    Replaces = Replaces.merge(FormatChanges);
-    IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> InMemoryFileSystem(
-        new llvm::vfs::InMemoryFileSystem);
-    clang::FileManager Files(clang::FileSystemOptions(), InMemoryFileSystem);
-    clang::DiagnosticsEngine Diagnostics(
-        IntrusiveRefCntPtr<clang::DiagnosticIDs>(new clang::DiagnosticIDs),
-        new clang::DiagnosticOptions);
-    clang::SourceManager Sources(Diagnostics, Files);
-    clang::FileID ID = createInMemoryFile(FileName, Code.get(), Sources, Files,
-                                          InMemoryFileSystem.get());
-    clang::Rewriter Rewrite(Sources, clang::LangOptions());
-    clang::tooling::applyAllReplacements(Replaces, Rewrite);
-    if (Rewrite.overwriteChangedFiles())
-        return true;
-    return false;
+    m_line.clear();
 }
+
+} // namespace format
 } // namespace spmdfy
-} // namespace spmdfy
\ No newline at end of file
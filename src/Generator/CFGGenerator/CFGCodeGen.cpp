@@ -1,21 +1,23 @@
+#include <llvm/ADT/Twine.h>
+
+#include <spmdfy/CommandLineOpts.hpp>
 #include <spmdfy/Generator/CFGGenerator/CFGCodeGen.hpp>
+#include <spmdfy/Pass/Passes/InferUniformNodes.hpp>
+
+#include <algorithm>
 
 namespace spmdfy {
 namespace codegen {
 
-auto CFGCodeGen::get() -> std::string const {
+auto CFGCodeGen::emit() -> void {
     SPMDFY_INFO("Generating Code\n");
-    return traverseCFG();
+    traverseCFG();
 }
 
-auto CFGCodeGen::getFrom(cfg::CFGNode *) -> std::string const { return ""; }
-
-auto CFGCodeGen::traverseCFG() -> std::string const {
-    OStreamTy tu_gen;
+auto CFGCodeGen::traverseCFG() -> void {
     for (auto node : m_node) {
-        tu_gen << Visit(node);
+        Visit(node);
     }
-    return tu_gen.str();
 }
 
 // CodeGen Visitors
@@ -27,9 +29,7 @@ auto CFGCodeGen::traverseCFG() -> std::string const {
 #define STMT_DEF_VISITOR(NODE, NAME) DEF_VISITOR(NODE, Stmt, NAME)
 #define TYPE_DEF_VISITOR(NODE, NAME) DEF_VISITOR(NODE, Type, NAME)
 #define CFGNODE_DEF_VISITOR(NODE, NAME)                                        \
-    auto CFGCodeGen::Visit##NODE##Node(cfg::NODE##Node *NAME)->std::string
-
-#define CASTAS(TYPE, NODE) dynamic_cast<TYPE>(NODE)
+    auto CFGCodeGen::Visit##NODE##Node(cfg::NODE##Node *NAME)->void
 
 auto rmCastIf(const clang::Expr *expr) -> const clang::Expr * {
     if (llvm::isa<const clang::ImplicitCastExpr>(expr)) {
@@ -39,6 +39,398 @@ auto rmCastIf(const clang::Expr *expr) -> const clang::Expr * {
     return expr;
 }
 
+static auto collectSubscripts(const clang::Stmt *stmt,
+                              std::vector<const clang::ArraySubscriptExpr *>
+                                  &subscripts) -> void {
+    if (stmt == nullptr) {
+        return;
+    }
+    if (auto subscript = llvm::dyn_cast<clang::ArraySubscriptExpr>(stmt)) {
+        subscripts.push_back(subscript);
+    }
+    for (auto child : stmt->children()) {
+        collectSubscripts(child, subscripts);
+    }
+}
+
+/// collects the calls to atomics, warp intrinsics and math functions, inner
+/// calls before the outer ones
+/// \return true if the CUDA function is mapped to an ISPC one
+static auto isMappedCall(const std::string &name) -> bool {
+    return g_SpmdfyWarpMap.count(name) || g_SpmdfyAtomicMap.count(name) ||
+           g_SpmdfyMathInstrinsicsMap.count(name);
+}
+
+static auto collectMappedCalls(const clang::Stmt *stmt,
+                               std::vector<const clang::CallExpr *> &calls)
+    -> void {
+    if (stmt == nullptr) {
+        return;
+    }
+    for (auto child : stmt->children()) {
+        collectMappedCalls(child, calls);
+    }
+    if (auto call = llvm::dyn_cast<clang::CallExpr>(stmt)) {
+        auto callee = call->getDirectCallee();
+        if (callee && isMappedCall(callee->getNameAsString())) {
+            calls.push_back(call);
+        }
+    }
+}
+
+/// \return true if the type is a CUDA vector type like float4, which is mapped
+/// to an ISPC short vector
+static auto isVectorType(clang::QualType type) -> bool {
+    auto record_decl = type->getAsCXXRecordDecl();
+    return record_decl && g_SpmdfyTypeMap.count(record_decl->getNameAsString());
+}
+
+/// \return true if the consecutive vectors of the gang can be deinterleaved
+/// with aos_to_soa4 and soa_to_aos4
+static auto isWideVectorType(clang::QualType type) -> bool {
+    auto record_decl = type->getAsCXXRecordDecl();
+    if (!record_decl || !isVectorType(type)) {
+        return false;
+    }
+    llvm::StringRef name = record_decl->getName();
+    return name == "float4" || name == "int4" || name == "uint4";
+}
+
+static auto isSoAType(clang::QualType type) -> bool {
+    auto record_decl = type->getAsCXXRecordDecl();
+    return record_decl && cfg::isSoARecord(record_decl);
+}
+
+/// \return true if the pointer expression points into a __shared__ variable
+static auto isSharedAddress(const clang::Expr *addr) -> bool {
+    while (true) {
+        addr = addr->IgnoreParenImpCasts();
+        if (auto unop = llvm::dyn_cast<clang::UnaryOperator>(addr);
+            unop && unop->getOpcode() == clang::UO_AddrOf) {
+            addr = unop->getSubExpr();
+        } else if (auto subscript =
+                       llvm::dyn_cast<clang::ArraySubscriptExpr>(addr)) {
+            addr = subscript->getBase();
+        } else if (auto binop = llvm::dyn_cast<clang::BinaryOperator>(addr);
+                   binop && binop->isAdditiveOp()) {
+            addr = binop->getLHS()->getType()->isPointerType() ||
+                           binop->getLHS()->getType()->isArrayType()
+                       ? binop->getLHS()
+                       : binop->getRHS();
+        } else if (auto decl_ref = llvm::dyn_cast<clang::DeclRefExpr>(addr)) {
+            auto var_decl = llvm::dyn_cast<clang::VarDecl>(decl_ref->getDecl());
+            return var_decl && var_decl->hasAttr<clang::CUDASharedAttr>();
+        } else {
+            return false;
+        }
+    }
+}
+
+auto CFGCodeGen::getAtomic(const clang::CallExpr *call,
+                           const std::vector<std::string> &args,
+                           clang::Rewriter &rewriter) -> std::string {
+    bool result_used = isResultUsed(call);
+    std::string name = call->getDirectCallee()->getNameAsString();
+    std::string ispc_name = g_SpmdfyAtomicMap.at(name);
+    const clang::Expr *addr = call->getArg(0);
+    // a block runs on a single core and owns its shared memory, the atomic
+    // only has to be atomic across the gang
+    if (isSharedAddress(addr)) {
+        const std::string global = "_global";
+        ispc_name.replace(ispc_name.size() - global.size(), global.size(),
+                          "_local");
+    }
+    auto reduce = g_SpmdfyAtomicReduceMap.find(name);
+    if (reduce == g_SpmdfyAtomicReduceMap.end()) {
+        return ispc_name + "(" + strJoin(args.begin(), args.end()) + ")";
+    }
+    if (pass::isUniformAddress(addr, m_workspace.uniform_vars)) {
+        // one atomic for the whole gang, the old value of a program instance
+        // is offset by the values of the instances before it
+        std::string atomic = ispc_name + "(" + args[0] + ", " +
+                             reduce->second + "(" + args[1] + "))";
+        if (!result_used) {
+            return atomic;
+        }
+        if (name == "atomicAdd") {
+            return "(" + atomic + " + exclusive_scan_add(" + args[1] + "))";
+        }
+        if (name == "atomicSub") {
+            return "(" + atomic + " - exclusive_scan_add(" + args[1] + "))";
+        }
+    } else if (group_atomics && isStatement(call)) {
+        auto addr_of = llvm::dyn_cast<clang::UnaryOperator>(
+            addr->IgnoreParenImpCasts());
+        auto subscript =
+            addr_of && addr_of->getOpcode() == clang::UO_AddrOf
+                ? llvm::dyn_cast<clang::ArraySubscriptExpr>(
+                      addr_of->getSubExpr()->IgnoreParenImpCasts())
+                : nullptr;
+        if (subscript && !m_workspace.coalesced_access.count(subscript) &&
+            pass::isUniformExpr(subscript->getBase(),
+                                m_workspace.uniform_vars)) {
+            // the program instances sharing an index issue a single atomic
+            return "foreach_unique (spmdfy_index in " +
+                   rewriter.getRewrittenText(
+                       subscript->getIdx()->getSourceRange()) +
+                   ") {\n" + ispc_name + "(&" +
+                   rewriter.getRewrittenText(
+                       subscript->getBase()->getSourceRange()) +
+                   "[spmdfy_index], " + reduce->second + "(" + args[1] +
+                   "));\n}";
+        }
+    }
+    return ispc_name + "(" + strJoin(args.begin(), args.end()) + ")";
+}
+
+auto CFGCodeGen::getWarpIntrinsic(const clang::CallExpr *call,
+                                  std::vector<std::string> args)
+    -> std::string {
+    llvm::StringRef name = call->getDirectCallee()->getName();
+    std::string ispc_name = g_SpmdfyWarpMap.at(name.str());
+    // every lane of the gang takes part, the member mask is implied
+    if (name.endswith("_sync") && !args.empty()) {
+        args.erase(args.begin());
+    }
+    // CUDA wraps the source lane around the width, the lane passed to
+    // broadcast and shuffle must be below programCount
+    if (name == "__shfl_sync" && args.size() == 2 &&
+        pass::isUniformExpr(call->getArg(2), m_workspace.uniform_vars)) {
+        ispc_name = "broadcast";
+        args.back() = "(" + args.back() + ") & (programCount - 1)";
+    } else if (name.startswith("__shfl_") && args.size() == 2) {
+        args.push_back("programCount");
+    } else if (name == "__ballot_sync" || name == "__any_sync" ||
+               name == "__all_sync") {
+        args.back() = "(" + args.back() + ") != 0";
+    }
+    if (args.empty()) {
+        return ispc_name + "()";
+    }
+    return ispc_name + "(" + strJoin(args.begin(), args.end()) + ")";
+}
+
+auto CFGCodeGen::getMathFunction(const clang::CallExpr *call,
+                                 const std::vector<std::string> &args)
+    -> std::string {
+    std::string name = call->getDirectCallee()->getNameAsString();
+    const auto &lowering = g_SpmdfyMathInstrinsicsMap.at(name);
+    return (fast_math ? lowering.second : lowering.first) + "(" +
+           strJoin(args.begin(), args.end()) + ")";
+}
+
+auto CFGCodeGen::isWholeVectorRead(const clang::Expr *expr) -> bool {
+    const clang::Stmt *node = expr;
+    while (true) {
+        auto parents = m_ast_context.getParents(*node);
+        if (parents.empty() || !(node = parents[0].get<clang::Stmt>())) {
+            return false;
+        }
+        if (llvm::isa<clang::CXXConstructExpr>(node)) {
+            return true;
+        }
+        if (!llvm::isa<clang::ImplicitCastExpr>(node) &&
+            !llvm::isa<clang::ParenExpr>(node) &&
+            !llvm::isa<clang::MaterializeTemporaryExpr>(node)) {
+            return false;
+        }
+    }
+}
+
+auto CFGCodeGen::isResultUsed(const clang::Expr *expr) -> bool {
+    const clang::Stmt *node = expr;
+    while (true) {
+        auto parents = m_ast_context.getParents(*node);
+        if (parents.empty()) {
+            return false;
+        }
+        // e.g. the initializer of a VarDecl
+        auto parent = parents[0].get<clang::Stmt>();
+        if (!parent) {
+            return true;
+        }
+        if (auto cast = llvm::dyn_cast<clang::CastExpr>(parent)) {
+            if (cast->getType()->isVoidType()) {
+                return false;
+            }
+            if (llvm::isa<clang::ImplicitCastExpr>(cast)) {
+                node = parent;
+                continue;
+            }
+            return true;
+        }
+        if (llvm::isa<clang::ParenExpr>(parent) ||
+            llvm::isa<clang::FullExpr>(parent)) {
+            node = parent;
+            continue;
+        }
+        if (llvm::isa<clang::CompoundStmt>(parent)) {
+            return false;
+        }
+        if (auto binop = llvm::dyn_cast<clang::BinaryOperator>(parent);
+            binop && binop->getOpcode() == clang::BO_Comma) {
+            if (node == binop->getLHS()) {
+                return false;
+            }
+            node = parent;
+            continue;
+        }
+        // a statement nested in a control flow statement is only used as
+        // its condition
+        if (auto for_stmt = llvm::dyn_cast<clang::ForStmt>(parent)) {
+            return node == for_stmt->getCond();
+        }
+        if (auto if_stmt = llvm::dyn_cast<clang::IfStmt>(parent)) {
+            return node == if_stmt->getCond();
+        }
+        if (auto while_stmt = llvm::dyn_cast<clang::WhileStmt>(parent)) {
+            return node == while_stmt->getCond();
+        }
+        if (auto do_stmt = llvm::dyn_cast<clang::DoStmt>(parent)) {
+            return node == do_stmt->getCond();
+        }
+        if (llvm::isa<clang::SwitchCase>(parent) ||
+            llvm::isa<clang::LabelStmt>(parent)) {
+            return false;
+        }
+        return true;
+    }
+}
+
+auto CFGCodeGen::isStatement(const clang::Expr *expr) -> bool {
+    const clang::Stmt *node = expr;
+    while (true) {
+        auto parents = m_ast_context.getParents(*node);
+        auto parent = parents.empty() ? nullptr : parents[0].get<clang::Stmt>();
+        if (!parent) {
+            return false;
+        }
+        if (llvm::isa<clang::ImplicitCastExpr>(parent) ||
+            llvm::isa<clang::ParenExpr>(parent) ||
+            llvm::isa<clang::FullExpr>(parent)) {
+            node = parent;
+            continue;
+        }
+        if (llvm::isa<clang::CompoundStmt>(parent) ||
+            llvm::isa<clang::SwitchCase>(parent) ||
+            llvm::isa<clang::LabelStmt>(parent)) {
+            return true;
+        }
+        if (auto if_stmt = llvm::dyn_cast<clang::IfStmt>(parent)) {
+            return node == if_stmt->getThen() || node == if_stmt->getElse();
+        }
+        if (auto for_stmt = llvm::dyn_cast<clang::ForStmt>(parent)) {
+            return node == for_stmt->getBody();
+        }
+        if (auto while_stmt = llvm::dyn_cast<clang::WhileStmt>(parent)) {
+            return node == while_stmt->getBody();
+        }
+        if (auto do_stmt = llvm::dyn_cast<clang::DoStmt>(parent)) {
+            return node == do_stmt->getBody();
+        }
+        return false;
+    }
+}
+
+auto CFGCodeGen::rewriteSource(const clang::Stmt *stmt) -> std::string {
+    std::vector<const clang::ArraySubscriptExpr *> subscripts;
+    collectSubscripts(stmt, subscripts);
+    std::vector<const clang::CallExpr *> calls;
+    collectMappedCalls(stmt, calls);
+    clang::Rewriter rewriter(m_sm, m_lang_opts);
+    bool rewritten = false;
+    // a whole vector stored to a coalesced element, e.g. pos[i] = p
+    const clang::ArraySubscriptExpr *wide_store = nullptr;
+    if (auto assign = llvm::dyn_cast<clang::CXXOperatorCallExpr>(stmt);
+        assign && assign->getOperator() == clang::OO_Equal) {
+        auto lhs = llvm::dyn_cast<clang::ArraySubscriptExpr>(
+            assign->getArg(0)->IgnoreParenImpCasts());
+        if (lhs && isWideVectorType(lhs->getType()) &&
+            m_workspace.coalesced_access.count(lhs)) {
+            wide_store = lhs;
+        }
+    }
+    for (auto subscript : subscripts) {
+        auto coalesced = m_workspace.coalesced_access.find(subscript);
+        if (coalesced == m_workspace.coalesced_access.end() ||
+            subscript == wide_store) {
+            continue;
+        }
+        if (isWideVectorType(subscript->getType()) &&
+            isWholeVectorRead(subscript)) {
+            SPMDFY_INFO("Rewriting wide vector load {}", SRCSLICE(subscript));
+            rewriter.ReplaceText(subscript->getSourceRange(),
+                                 (llvm::Twine("__spmdfy_load4(") +
+                                  SRCSLICE(subscript->getBase()) + ", " +
+                                  coalesced->second + " + threadBase)")
+                                     .str());
+            rewritten = true;
+            continue;
+        }
+        SPMDFY_INFO("Rewriting coalesced access {}", SRCSLICE(subscript));
+        rewriter.ReplaceText(subscript->getIdx()->getSourceRange(),
+                             coalesced->second +
+                                 " + threadBase + programIndex");
+        rewritten = true;
+    }
+    // the arguments are read back with the rewrites of the inner expressions
+    for (auto call : calls) {
+        std::vector<std::string> args;
+        for (auto arg : call->arguments()) {
+            if (!llvm::isa<clang::CXXDefaultArgExpr>(arg)) {
+                args.push_back(
+                    rewriter.getRewrittenText(arg->getSourceRange()));
+            }
+        }
+        SPMDFY_INFO("Rewriting call {}", SRCSLICE(call));
+        std::string name = call->getDirectCallee()->getNameAsString();
+        rewriter.ReplaceText(call->getSourceRange(),
+                             g_SpmdfyWarpMap.count(name)
+                                 ? getWarpIntrinsic(call, args)
+                                 : g_SpmdfyAtomicMap.count(name)
+                                       ? getAtomic(call, args, rewriter)
+                                       : getMathFunction(call, args));
+        rewritten = true;
+    }
+    if (wide_store) {
+        SPMDFY_INFO("Rewriting wide vector store {}", SRCSLICE(stmt));
+        auto assign = llvm::cast<clang::CXXOperatorCallExpr>(stmt);
+        std::string value =
+            rewriter.getRewrittenText(assign->getArg(1)->getSourceRange());
+        rewriter.ReplaceText(
+            stmt->getSourceRange(),
+            (llvm::Twine("__spmdfy_store4(") +
+             SRCSLICE(wide_store->getBase()) + ", " +
+             m_workspace.coalesced_access.at(wide_store) + " + threadBase, " +
+             value + ")")
+                .str());
+        rewritten = true;
+    }
+    if (!rewritten) {
+        return SRCSLICE(stmt).str();
+    }
+    return rewriter.getRewrittenText(stmt->getSourceRange());
+}
+
+auto CFGCodeGen::getSpillDecl(const clang::VarDecl *var_decl) -> std::string {
+    std::string uniform =
+        m_workspace.uniform_vars.count(var_decl) ? "uniform " : "";
+    return uniform + VisitQualType(var_decl->getType().getUnqualifiedType()) +
+           " " + var_decl->getNameAsString();
+}
+
+auto CFGCodeGen::getSpillSlot(const clang::VarDecl *var_decl) -> std::string {
+    // threadIdx.y and threadIdx.z are uniform, so the program instances of the
+    // gang access consecutive elements and a uniform value a single one
+    std::string slot = "spill_" + var_decl->getNameAsString() +
+                       "[(threadIdx.z * blockDim.y + threadIdx.y) * "
+                       "blockDim.x + threadBase";
+    if (!m_workspace.uniform_vars.count(var_decl)) {
+        slot += " + programIndex";
+    }
+    return slot + "]";
+}
+
 std::string CFGCodeGen::getISPCBaseType(std::string from) {
     std::string to = from;
     if (g_SpmdfyTypeMap.find(from) != g_SpmdfyTypeMap.end()) {
@@ -91,21 +483,22 @@ TYPE_DEF_VISITOR(Record, record) {
                 record->getDecl()->getNameAsString());
     OStreamTy record_gen;
 
-    record_gen << record->getDecl()->getNameAsString();
+    record_gen << getISPCBaseType(record->getDecl()->getNameAsString());
 
     return record_gen.str();
 }
 
 DECL_DEF_VISITOR(ParmVar, param_decl) {
-    SPMDFY_INFO("Visiting ParmVarDecl: {}", SRCDUMP(param_decl));
+    SPMDFY_INFO("Visiting ParmVarDecl: {}", SRCSLICE(param_decl));
     OStreamTy param_gen;
     if (m_tu_context == cfg::CFGNode::Context::Kernel) {
         clang::QualType param_type = param_decl->getType();
         param_gen << "uniform ";
         if (param_type->isPointerType()) {
-            param_gen << getISPCBaseType(
-                             param_type->getPointeeType().getAsString())
-                      << " ";
+            if (isSoAType(param_type->getPointeeType())) {
+                param_gen << "soa<" << soa_width << "> ";
+            }
+            param_gen << VisitQualType(param_type->getPointeeType()) << " ";
             param_gen << param_decl->getNameAsString() << "[]";
         } else {
             param_gen << VisitVarDecl(
@@ -117,11 +510,12 @@ DECL_DEF_VISITOR(ParmVar, param_decl) {
 }
 
 DECL_DEF_VISITOR(Var, var_decl) {
-    SPMDFY_INFO("Visiting VarDecl: {}", SRCDUMP(var_decl));
+    SPMDFY_INFO("Visiting VarDecl: {}", SRCSLICE(var_decl));
     OStreamTy var_gen;
     if (m_tu_context == cfg::CFGNode::Context::Global) {
         var_gen << "const uniform ";
-    } else if (var_decl->hasAttr<clang::CUDASharedAttr>()) {
+    } else if (var_decl->hasAttr<clang::CUDASharedAttr>() ||
+               m_workspace.uniform_vars.count(var_decl)) {
         var_gen << "uniform ";
     }
 
@@ -136,9 +530,10 @@ DECL_DEF_VISITOR(Var, var_decl) {
 
     if (type->isIncompleteType() &&
         var_decl->hasAttr<clang::CUDASharedAttr>()) {
-        var_name = "* " + var_name;
-        var_name +=
-            " = uniform new uniform " + var_base_type + "[shared_memory_size]";
+        // every extern shared array starts at the dynamic shared memory
+        // allocated by the kernel
+        var_name = "* " + var_name + " = (uniform " + var_base_type +
+                   " * uniform)spmdfy_shared_memory";
     } else if (type->isConstantArrayType()) {
         do {
             auto const_arr_type = clang::cast<clang::ConstantArrayType>(type);
@@ -149,14 +544,15 @@ DECL_DEF_VISITOR(Var, var_decl) {
             type = const_arr_type->getElementType();
         } while (type->isConstantArrayType());
         var_base_type = getISPCBaseType(type.getAsString());
-    } else if (!type->isBuiltinType() && !type->isPointerType()) {
+    } else if (!type->isBuiltinType() && !type->isPointerType() &&
+               !isVectorType(type) && !isSoAType(type)) {
         SPMDFY_ERROR("Not Builtin Type: {}", type.getAsString());
         var_name = "&" + var_name;
     }
 
     if (const clang::Expr *initwc = var_decl->getInit(); (initwc)) {
         const clang::Expr *init = rmCastIf(initwc);
-        std::string var_init = SRCDUMP(init);
+        std::string var_init = rewriteSource(init);
         if (var_base_type.find("int8") != -1) {
             if (llvm::isa<const clang::CharacterLiteral>(init)) {
                 var_init = std::to_string(
@@ -164,12 +560,18 @@ DECL_DEF_VISITOR(Var, var_decl) {
                         ->getValue());
             }
         }
-        var_name += " = ";
         if (type->isPointerType() &&
             llvm::isa<clang::CXXNullPtrLiteralExpr>(init)) {
             var_init = "NULL";
         }
-        if (!type->isBuiltinType()) {
+        if (auto ctor_expr = llvm::dyn_cast<clang::CXXConstructExpr>(init);
+            ctor_expr && (isVectorType(type) || isSoAType(type))) {
+            // short vectors and the elements of soa<> arrays are copied by
+            // assignment and left undefined by the default constructor
+            var_init = ctor_expr->getNumArgs()
+                           ? rewriteSource(ctor_expr->getArg(0))
+                           : std::string();
+        } else if (!type->isBuiltinType()) {
             if (llvm::isa<const clang::CXXConstructExpr>(init)) {
                 SPMDFY_INFO("Generating CXXConstructExpr");
                 const clang::CXXConstructExpr *ctor_expr =
@@ -179,14 +581,16 @@ DECL_DEF_VISITOR(Var, var_decl) {
                 for (int i = 0; i < ctor_expr->getNumArgs(); i++) {
                     ctor_type +=
                         "_" + ctor_expr->getArg(i)->getType().getAsString();
-                    ctor_args.push_back(SRCDUMP(ctor_expr->getArg(i)));
+                    ctor_args.push_back(SRCSLICE(ctor_expr->getArg(i)).str());
                 }
                 var_init = var_base_type + "_ctor" + ctor_type + "(";
                 var_init += strJoin(ctor_args.begin(), ctor_args.end());
                 var_init += ")";
             }
         }
-        var_name += var_init;
+        if (!var_init.empty()) {
+            var_name += " = " + var_init;
+        }
     }
 
     var_gen << var_base_type << " " << var_name;
@@ -198,7 +602,8 @@ DECL_DEF_VISITOR(Function, func_decl) {
     OStreamTy func_gen;
 
     if (m_tu_context == cfg::CFGNode::Kernel) {
-        func_gen << "ISPC_KERNEL(" << func_decl->getNameAsString();
+        func_gen << (ispc_tasks ? "ISPC_TASK_KERNEL(" : "ISPC_KERNEL(")
+                 << cfg::getKernelName(func_decl);
         auto params = func_decl->parameters();
         for (auto param : params) {
             func_gen << ", " << Visit(param);
@@ -209,54 +614,306 @@ DECL_DEF_VISITOR(Function, func_decl) {
     return func_gen.str();
 }
 
+DECL_DEF_VISITOR(CXXRecord, record_decl) {
+    SPMDFY_INFO("Visiting CXXRecordDecl: {}", record_decl->getNameAsString());
+    OStreamTy record_gen;
+    record_gen << "struct " << record_decl->getNameAsString() << " {\n";
+    for (auto field : record_decl->fields()) {
+        std::string field_name = field->getNameAsString();
+        clang::QualType type = field->getType();
+        while (auto array_type = m_ast_context.getAsConstantArrayType(type)) {
+            field_name += "[" + array_type->getSize().toString(10, false) + "]";
+            type = array_type->getElementType();
+        }
+        record_gen << VisitQualType(type) << " " << field_name << ";\n";
+    }
+    record_gen << "};\n";
+    return record_gen.str();
+}
+
+auto CFGCodeGen::emitRecord(const clang::CXXRecordDecl *record_decl)
+    -> void {
+    m_tu_context = cfg::CFGNode::Context::Global;
+    m_out << VisitCXXRecordDecl(record_decl);
+    std::string name = record_decl->getNameAsString();
+    if (!cfg::isSoARecord(record_decl)) {
+        if (cfg::isSoAMarked(record_decl)) {
+            llvm::errs() << "[SPMDFY] warning: " << name
+                         << " has non scalar fields, its arrays are kept as "
+                            "arrays of structs\n";
+        }
+        return;
+    }
+    // the kernels index the soa<> arrays like the arrays of structs, the host
+    // converts its arrays before and after the launch
+    std::string soa_type = "soa<" + std::to_string(soa_width) + "> " + name;
+    m_out << "export void " << name << "_to_soa(uniform " << name
+          << " src[], uniform " << soa_type << " dst[], uniform int count) {\n"
+          << "foreach (i = 0 ... count) {\n"
+          << "dst[i] = src[i];\n"
+          << "}\n"
+          << "}\n";
+    m_out << "export void " << name << "_from_soa(uniform " << soa_type
+          << " src[], uniform " << name << " dst[], uniform int count) {\n"
+          << "foreach (i = 0 ... count) {\n"
+          << "dst[i] = src[i];\n"
+          << "}\n"
+          << "}\n";
+}
+
+/// \return true if the kernel declares an extern shared array, whose size is
+/// given at the launch
+static auto hasDynamicSharedMemory(const clang::Stmt *stmt) -> bool {
+    if (stmt == nullptr) {
+        return false;
+    }
+    if (auto decl_stmt = llvm::dyn_cast<clang::DeclStmt>(stmt)) {
+        for (auto decl : decl_stmt->decls()) {
+            auto var_decl = llvm::dyn_cast<clang::VarDecl>(decl);
+            if (var_decl && var_decl->hasAttr<clang::CUDASharedAttr>() &&
+                var_decl->getType()->isIncompleteType()) {
+                return true;
+            }
+        }
+    }
+    for (auto child : stmt->children()) {
+        if (hasDynamicSharedMemory(child)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+auto CFGCodeGen::getTemplateArgDefines(const clang::FunctionDecl *func_decl)
+    -> std::vector<std::pair<std::string, std::string>> {
+    std::vector<std::pair<std::string, std::string>> defines;
+    if (!clang::isTemplateInstantiation(
+            func_decl->getTemplateSpecializationKind())) {
+        return defines;
+    }
+    auto params = func_decl->getPrimaryTemplate()->getTemplateParameters();
+    auto args = func_decl->getTemplateSpecializationArgs()->asArray();
+    for (unsigned i = 0; i < params->size() && i < args.size(); i++) {
+        std::string value =
+            args[i].getKind() == clang::TemplateArgument::Type
+                ? VisitQualType(args[i].getAsType())
+                : args[i].getAsIntegral().toString(10);
+        defines.emplace_back(params->getParam(i)->getNameAsString(), value);
+    }
+    return defines;
+}
+
 CFGNODE_DEF_VISITOR(KernelFunc, kernel) {
-    OStreamTy kernel_gen;
     m_tu_context = cfg::CFGNode::Context::Kernel;
-    kernel_gen << Visit(kernel->getKernelNode());
+    // the kernel is generated from the source of the template, its parameters
+    // are substituted by the preprocessor
+    auto defines = getTemplateArgDefines(kernel->getKernelNode());
+    for (const auto &define : defines) {
+        m_out << "#define " << define.first << " " << define.second << "\n";
+    }
+    auto func_decl = kernel->getKernelNode();
+    std::vector<const clang::VarDecl *> spilled_vars;
+    if (auto spilled = m_workspace.spilled_vars.find(kernel->getName());
+        spilled != m_workspace.spilled_vars.end()) {
+        spilled_vars = spilled->second;
+    }
+    auto fixed_dim = getFixedBlockDim(func_decl);
+    // the heap buffers are owned by the kernel and passed to its body
+    bool owns_buffers =
+        !spilled_vars.empty() || hasDynamicSharedMemory(func_decl->getBody());
+    if (owns_buffers) {
+        m_out << "ISPC_KERNEL_BODY(" << cfg::getKernelName(func_decl);
+        for (auto param : func_decl->parameters()) {
+            m_out << ", " << Visit(param);
+        }
+        m_out << ", uniform int8 *uniform spmdfy_shared_memory";
+        for (auto var_decl : spilled_vars) {
+            m_out << ", uniform "
+                  << VisitQualType(var_decl->getType().getUnqualifiedType())
+                  << " *uniform spill_" << var_decl->getName();
+        }
+        m_out << "){\n";
+    } else {
+        m_out << Visit(func_decl);
+    }
+    if (fixed_dim) {
+        // ISPC unrolls the block loops of the specialized kernel and the
+        // spill buffers have a static size
+        std::string dim = std::to_string((*fixed_dim)[0]) + ", " +
+                          std::to_string((*fixed_dim)[1]) + ", " +
+                          std::to_string((*fixed_dim)[2]);
+        m_out << "if (ISPC_IS_BLOCK_DIM(" << dim << ")) {\n"
+              << "ISPC_FIXED_BLOCK_DIM(" << dim << ");\n";
+        for (auto var_decl : spilled_vars) {
+            m_out << "uniform "
+                  << VisitQualType(var_decl->getType().getUnqualifiedType())
+                  << " spill_" << var_decl->getName() << "["
+                  << (*fixed_dim)[0] * (*fixed_dim)[1] * (*fixed_dim)[2]
+                  << "];\n";
+        }
+        m_fixed_block = true;
+        emitKernelBody(kernel);
+        m_fixed_block = false;
+        m_out << "} else {\n";
+        emitGenericKernelBody(kernel);
+        m_out << "}\n";
+    } else {
+        emitGenericKernelBody(kernel);
+    }
+    m_out << "}\n";
+    if (owns_buffers) {
+        emitBufferOwner(func_decl, spilled_vars, fixed_dim);
+    }
+    if (ispc_tasks) {
+        emitTaskLauncher(kernel->getKernelNode());
+    }
+    for (const auto &define : defines) {
+        m_out << "#undef " << define.first << "\n";
+    }
+}
+
+auto CFGCodeGen::emitGenericKernelBody(cfg::KernelFuncNode *kernel) -> void {
+    if (!no_warp_block) {
+        // a block of one gang runs in lockstep without the threadIdx loop
+        m_out << "if (ISPC_IS_WARP_BLOCK) {\n";
+        m_warp_block = true;
+        emitKernelBody(kernel);
+        m_warp_block = false;
+        m_out << "} else {\n";
+        emitKernelBody(kernel);
+        m_out << "}\n";
+    } else {
+        emitKernelBody(kernel);
+    }
+}
+
+auto CFGCodeGen::emitBufferOwner(
+    const clang::FunctionDecl *func_decl,
+    const std::vector<const clang::VarDecl *> &spilled_vars,
+    const std::optional<std::array<unsigned, 3>> &fixed_dim) -> void {
+    std::string name = cfg::getKernelName(func_decl);
+    m_out << (ispc_tasks ? "ISPC_TASK_KERNEL(" : "ISPC_KERNEL(") << name;
+    for (auto param : func_decl->parameters()) {
+        m_out << ", " << Visit(param);
+    }
+    m_out << "){\n";
+    m_out << "uniform int8 *uniform spmdfy_shared_memory = "
+          << (hasDynamicSharedMemory(func_decl->getBody())
+                  ? "uniform new uniform int8[shared_memory_size]"
+                  : "NULL")
+          << ";\n";
+    for (auto var_decl : spilled_vars) {
+        m_out << "uniform "
+              << VisitQualType(var_decl->getType().getUnqualifiedType())
+              << " *uniform spill_" << var_decl->getName() << " = NULL;\n";
+    }
+    // the specialized body keeps its spill buffers on the stack
+    if (!spilled_vars.empty()) {
+        if (fixed_dim) {
+            m_out << "if (!ISPC_IS_BLOCK_DIM(" << (*fixed_dim)[0] << ", "
+                  << (*fixed_dim)[1] << ", " << (*fixed_dim)[2] << ")) {\n";
+        }
+        for (auto var_decl : spilled_vars) {
+            m_out << "spill_" << var_decl->getName()
+                  << " = uniform new uniform "
+                  << VisitQualType(var_decl->getType().getUnqualifiedType())
+                  << "[blockDim.x * blockDim.y * blockDim.z];\n";
+        }
+        if (fixed_dim) {
+            m_out << "}\n";
+        }
+    }
+    m_out << (ispc_tasks ? "ISPC_TASK_BODY_CALL(" : "ISPC_KERNEL_BODY_CALL(")
+          << name;
+    for (auto param : func_decl->parameters()) {
+        m_out << ", " << param->getName();
+    }
+    m_out << ", spmdfy_shared_memory";
+    for (auto var_decl : spilled_vars) {
+        m_out << ", spill_" << var_decl->getName();
+    }
+    m_out << ");\n";
+    m_out << "delete[] spmdfy_shared_memory;\n";
+    for (auto var_decl : spilled_vars) {
+        m_out << "delete[] spill_" << var_decl->getName() << ";\n";
+    }
+    m_out << "}\n";
+}
+
+auto CFGCodeGen::getFixedBlockDim(const clang::FunctionDecl *func_decl)
+    -> std::optional<std::array<unsigned, 3>> {
+    std::array<unsigned, 3> dim = {1, 1, 1};
+    if (!block_dim.empty()) {
+        std::copy(block_dim.begin(), block_dim.end(), dim.begin());
+        return dim;
+    }
+    // the launch bounds only limit the number of threads of a block, the
+    // common one dimensional block of that size is specialized
+    if (auto bounds = func_decl->getAttr<clang::CUDALaunchBoundsAttr>()) {
+        clang::Expr::EvalResult max_threads;
+        if (bounds->getMaxThreads()->EvaluateAsInt(max_threads,
+                                                   m_ast_context) &&
+            max_threads.Val.getInt().isStrictlyPositive()) {
+            dim[0] = max_threads.Val.getInt().getZExtValue();
+            return dim;
+        }
+    }
+    return std::nullopt;
+}
+
+auto CFGCodeGen::emitKernelBody(cfg::KernelFuncNode *kernel) -> void {
     cfg::CFGNode *curr_node = kernel->getNext();
     while (curr_node->getNodeType() != cfg::CFGNode::Exit) {
         SPMDFY_INFO("Current Internal node: {}", curr_node->getName());
-        kernel_gen << Visit(curr_node);
+        Visit(curr_node);
         if (curr_node->getNodeType() == cfg::CFGNode::IfStmt) {
-            if (CASTAS(cfg::IfStmtNode *, curr_node)) {
-                curr_node = CASTAS(cfg::IfStmtNode *, curr_node)->getReconv();
+            if (auto if_node = llvm::dyn_cast<cfg::IfStmtNode>(curr_node)) {
+                curr_node = if_node->getReconv();
                 SPMDFY_INFO("Casting to IfStmtNode");
             }
         }
         if (curr_node->getNodeType() == cfg::CFGNode::ForStmt) {
-            if (CASTAS(cfg::ForStmtNode *, curr_node)) {
-                curr_node = CASTAS(cfg::ForStmtNode *, curr_node)->getReconv();
+            if (auto for_node = llvm::dyn_cast<cfg::ForStmtNode>(curr_node)) {
+                curr_node = for_node->getReconv();
                 SPMDFY_INFO("Casting to ForStmtNode");
             }
         }
         curr_node = curr_node->getNext();
     }
-    kernel_gen << "}\n";
-    return kernel_gen.str();
+}
+
+auto CFGCodeGen::emitTaskLauncher(const clang::FunctionDecl *func_decl)
+    -> void {
+    SPMDFY_INFO("Generating task launcher {}", func_decl->getNameAsString());
+    m_out << "ISPC_KERNEL(" << cfg::getKernelName(func_decl);
+    for (auto param : func_decl->parameters()) {
+        m_out << ", " << Visit(param);
+    }
+    m_out << "){\n";
+    m_out << "ISPC_TASK_LAUNCH(" << cfg::getKernelName(func_decl);
+    for (auto param : func_decl->parameters()) {
+        m_out << ", " << param->getName();
+    }
+    m_out << ");\n}\n";
 }
 
 CFGNODE_DEF_VISITOR(IfStmt, ifstmt) {
     SPMDFY_INFO("CodeGen IfStmt Node");
-    OStreamTy ifstmt_gen;
-
     auto if_stmt = ifstmt->getIfStmt();
-    ifstmt_gen << "if (";
+    m_out << "if (";
     auto *if_cond = if_stmt->getCond();
     if (if_cond) {
-        ifstmt_gen << sourceDump(m_sm, m_lang_opts,
-                                 if_cond->getSourceRange().getBegin(),
-                                 if_cond->getSourceRange().getEnd())
-                   << ")";
+        m_out << rewriteSource(if_cond) << ")";
     }
-    ifstmt_gen << "{\n";
+    m_out << "{\n";
     SPMDFY_INFO("Generating True block");
     for (auto curr_node = ifstmt->getNext();
          curr_node->getNodeType() != cfg::CFGNode::Reconv;
          curr_node = curr_node->getNext()) {
-        ifstmt_gen << Visit(curr_node);
+        Visit(curr_node);
         if (curr_node->getNodeType() == cfg::CFGNode::IfStmt) {
-            if (CASTAS(cfg::IfStmtNode *, curr_node)) {
-                curr_node = CASTAS(cfg::IfStmtNode *, curr_node)->getReconv();
+            if (auto if_node = llvm::dyn_cast<cfg::IfStmtNode>(curr_node)) {
+                curr_node = if_node->getReconv();
                 continue;
             }
         }
@@ -266,61 +923,52 @@ CFGNODE_DEF_VISITOR(IfStmt, ifstmt) {
     for (auto curr_node = ifstmt->getFalseBlock();
          curr_node->getNodeType() != cfg::CFGNode::Reconv;
          curr_node = curr_node->getNext()) {
-        ifstmt_gen << Visit(curr_node);
+        Visit(curr_node);
     }
-    ifstmt_gen << "}\n";
-
-    return ifstmt_gen.str();
+    m_out << "}\n";
 }
 
 CFGNODE_DEF_VISITOR(ForStmt, forstmt) {
     SPMDFY_INFO("Codegen ForStmt {}", forstmt->getName());
-    OStreamTy for_gen;
-
     auto for_stmt = forstmt->getForStmt();
     auto for_body = for_stmt->getBody();
 
-    for_gen << sourceDump(m_sm, m_lang_opts,
-                          for_stmt->getSourceRange().getBegin(),
-                          for_body->getSourceRange().getBegin());
+    std::string for_header =
+        sourceDump(m_sm, m_lang_opts, for_stmt->getSourceRange().getBegin(),
+                   for_body->getSourceRange().getBegin());
+    if (auto init = llvm::dyn_cast_or_null<clang::DeclStmt>(
+            for_stmt->getInit());
+        init && init->isSingleDecl()) {
+        auto var_decl = llvm::dyn_cast<clang::VarDecl>(init->getSingleDecl());
+        if (var_decl && m_workspace.uniform_vars.count(var_decl)) {
+            for_header.insert(for_header.find('(') + 1, "uniform ");
+        }
+    }
+    m_out << for_header;
     for (auto curr_node = forstmt->getNext();
          curr_node->getNodeType() != cfg::CFGNode::Reconv;
          curr_node = curr_node->getNext()) {
         SPMDFY_INFO("ForStmt Codegen {}", curr_node->getNodeTypeName());
-        for_gen << Visit(curr_node);
+        Visit(curr_node);
         if (curr_node->getNodeType() == cfg::CFGNode::IfStmt) {
-            if (CASTAS(cfg::IfStmtNode *, curr_node)) {
-                curr_node = CASTAS(cfg::IfStmtNode *, curr_node)->getReconv();
+            if (auto if_node = llvm::dyn_cast<cfg::IfStmtNode>(curr_node)) {
+                curr_node = if_node->getReconv();
                 continue;
             }
         }
     }
-    for_gen << "}\n";
-    return for_gen.str();
+    m_out << "}\n";
 }
 
 DEF_VISITOR(Call, Expr, call_expr) {
-    SPMDFY_INFO("Visiting CallExpr: {}", SRCDUMP(call_expr));
+    SPMDFY_INFO("Visiting CallExpr: {}", SRCSLICE(call_expr));
     std::ostringstream call_gen;
     const clang::FunctionDecl *callee = call_expr->getDirectCallee();
     std::string callee_name = callee->getNameAsString();
     if (callee_name == "printf") {
         return std::string();
     }
-    if (auto is_atomic = g_SpmdfyAtomicMap.find(callee_name);
-        is_atomic != g_SpmdfyAtomicMap.end()) {
-        const auto args = call_expr->getArgs();
-        call_gen << is_atomic->second << "(";
-        if (is_atomic->first != "atomicCAS") {
-            call_gen << SRCDUMP(args[0]) << ", " << SRCDUMP(args[1]);
-        } else {
-            call_gen << SRCDUMP(args[0]) << ", " << SRCDUMP(args[1]) << ", "
-                     << SRCDUMP(args[2]);
-        }
-        call_gen << ")";
-        return call_gen.str();
-    }
-    call_gen << SRCDUMP(call_expr);
+    call_gen << rewriteSource(call_expr);
     return call_gen.str();
 }
 
@@ -330,7 +978,6 @@ DEF_VISITOR(Call, Expr, call_expr) {
 
 CFGNODE_DEF_VISITOR(Internal, internal) {
     SPMDFY_INFO("CodeGen InternalNode {}", internal->getName());
-    OStreamTy internal_gen;
     const std::string &node_name = internal->getInternalNodeName();
     if (auto src = std::visit(
             Overload([&](const clang::Decl *decl) { return Visit(decl); },
@@ -339,32 +986,66 @@ CFGNODE_DEF_VISITOR(Internal, internal) {
                      [&](const clang::Type *type) { return Visit(type); }),
             internal->getInternalNode());
         src != "") {
-        internal_gen << src;
+        m_out << src;
     } else {
-        internal_gen << internal->getSource();
+        m_out << std::visit(
+            Overload([&](const clang::Decl *) {
+                         return internal->getSource().str();
+                     },
+                     [&](const clang::Stmt *stmt) {
+                         return rewriteSource(stmt);
+                     },
+                     [&](const clang::Expr *expr) {
+                         return rewriteSource(expr);
+                     },
+                     [&](const clang::Type *) {
+                         return internal->getSource().str();
+                     }),
+            internal->getInternalNode());
     }
-    internal_gen << ";\n";
-    return internal_gen.str();
+    m_out << ";\n";
 }
 
 CFGNODE_DEF_VISITOR(ISPCBlock, ispc_block) {
     SPMDFY_INFO("CodeGen ISPCBlock Node");
-    return "ISPC_BLOCK_START\n";
+    m_out << (m_warp_block    ? "ISPC_WARP_BLOCK_START\n"
+              : m_fixed_block ? "ISPC_FIXED_BLOCK_START\n"
+                              : "ISPC_BLOCK_START\n");
+    if (auto redeclared = m_workspace.redeclared_vars.find(ispc_block);
+        redeclared != m_workspace.redeclared_vars.end()) {
+        for (auto var_decl : redeclared->second) {
+            m_out << getSpillDecl(var_decl) << ";\n";
+        }
+    }
+    if (auto loads = m_workspace.spill_loads.find(ispc_block);
+        loads != m_workspace.spill_loads.end()) {
+        for (auto var_decl : loads->second) {
+            m_out << getSpillDecl(var_decl) << " = " << getSpillSlot(var_decl)
+                  << ";\n";
+        }
+    }
 }
 
 CFGNODE_DEF_VISITOR(ISPCBlockExit, ispc_block) {
     SPMDFY_INFO("CodeGen ISPCBlockExit Node");
-    return "ISPC_BLOCK_END\n";
+    if (auto stores = m_workspace.spill_stores.find(ispc_block);
+        stores != m_workspace.spill_stores.end()) {
+        for (auto var_decl : stores->second) {
+            m_out << getSpillSlot(var_decl) << " = " << var_decl->getName()
+                  << ";\n";
+        }
+    }
+    m_out << (m_warp_block ? "ISPC_WARP_BLOCK_END\n" : "ISPC_BLOCK_END\n");
 }
 
 CFGNODE_DEF_VISITOR(ISPCGrid, ispc_block) {
     SPMDFY_INFO("CodeGen ISPCGrid Node");
-    return "ISPC_GRID_START\n";
+    m_out << (ispc_tasks ? "ISPC_TASK_GRID_START\n" : "ISPC_GRID_START\n");
 }
 
 CFGNODE_DEF_VISITOR(ISPCGridExit, ispc_block) {
     SPMDFY_INFO("CodeGen ISPCGridExit Node");
-    return "ISPC_GRID_END\n";
+    m_out << (ispc_tasks ? "ISPC_TASK_GRID_END\n" : "ISPC_GRID_END\n");
 }
 
 } // namespace codegen
@@ -2,6 +2,18 @@
 
 namespace spmdfy {
 
+/// \return true if the template arguments of the specialization can be
+/// substituted in the ISPC source
+static auto isInstantiable(const clang::FunctionDecl *spec) -> bool {
+    for (const auto &arg : spec->getTemplateSpecializationArgs()->asArray()) {
+        if (arg.getKind() != clang::TemplateArgument::Type &&
+            arg.getKind() != clang::TemplateArgument::Integral) {
+            return false;
+        }
+    }
+    return true;
+}
+
 auto CFGGenerator::handleTranslationUnit(clang::ASTContext &context) -> bool {
     clang::DeclContext *traverse_decl =
         llvm::dyn_cast<clang::DeclContext>(context.getTranslationUnitDecl());
@@ -10,17 +22,69 @@ auto CFGGenerator::handleTranslationUnit(clang::ASTContext &context) -> bool {
         return true;
     }
 
-    ConstructSpmdCFG cfg(m_context);
+    // the CFG nodes, passes and codegen slice the same nodes repeatedly
+    SourceSlicer slicer(m_sm, m_lang_opts);
+    ConstructSpmdCFG cfg(m_context, m_arena);
 
     for (auto D : traverse_decl->decls()) {
         if (!isExpansionInMainFile(m_sm, D)) {
             continue;
         }
         switch (D->getKind()) {
-        case clang::Decl::Function:
-            if(cfg.add(llvm::cast<const clang::FunctionDecl>(D)))
+        case clang::Decl::Function: {
+            auto func_decl = llvm::cast<const clang::FunctionDecl>(D);
+            // host functions are left to the host code
+            if (!func_decl->hasAttr<clang::CUDAGlobalAttr>() &&
+                !func_decl->hasAttr<clang::CUDADeviceAttr>()) {
+                break;
+            }
+            if(cfg.add(func_decl))
                 SPMDFY_ERROR("Unable to add FunctionDecl");
             break;
+        }
+        case clang::Decl::FunctionTemplate: {
+            auto func_template = llvm::cast<clang::FunctionTemplateDecl>(D);
+            auto templated_decl = func_template->getTemplatedDecl();
+            if (!templated_decl->hasAttr<clang::CUDAGlobalAttr>()) {
+                if (templated_decl->hasAttr<clang::CUDADeviceAttr>() &&
+                    !func_template->specializations().empty()) {
+                    llvm::errs() << "[SPMDFY] warning: skipping "
+                                 << func_template->getNameAsString()
+                                 << ", __device__ function templates are "
+                                    "not supported\n";
+                }
+                break;
+            }
+            // one kernel per specialization the host code instantiates, both
+            // implicitly and explicitly, the explicit specializations are
+            // visited as functions and extern templates are defined in
+            // another translation unit
+            for (auto spec : func_template->specializations()) {
+                auto kind = spec->getTemplateSpecializationKind();
+                if (!clang::isTemplateInstantiation(kind) ||
+                    kind == clang::TSK_ExplicitInstantiationDeclaration ||
+                    !spec->hasBody()) {
+                    continue;
+                }
+                if (!isInstantiable(spec)) {
+                    llvm::errs() << "[SPMDFY] warning: skipping "
+                                 << spec->getNameAsString()
+                                 << ", only type and integral template "
+                                    "arguments are supported\n";
+                    continue;
+                }
+                if (cfg.add(spec))
+                    SPMDFY_ERROR("Unable to add FunctionDecl");
+            }
+            break;
+        }
+        case clang::Decl::CXXRecord: {
+            auto record_decl = llvm::cast<const clang::CXXRecordDecl>(D);
+            if (record_decl->isThisDeclarationADefinition() &&
+                cfg.add(record_decl))
+                SPMDFY_ERROR("Unable to add CXXRecordDecl");
+            break;
+        }
         default:
             SPMDFY_ERROR("{} not supported yet!", D->getDeclKindName());
             break;
@@ -29,13 +93,15 @@ auto CFGGenerator::handleTranslationUnit(clang::ASTContext &context) -> bool {
 
     m_spmd_tutbl = cfg.get();
 
-    pass::PassManager pm(m_context, m_spmd_tutbl);
+    pass::PassManager pm(m_context, m_spmd_tutbl, m_arena);
     pm.runPassSequence();
 
-    codegen::CFGCodeGen generator(m_context, m_spmd_tutbl);
-    m_file_writer << generator.get();
-
-    SPMDFY_INFO("Translation Unit:\n{}", m_file_writer.str());
+    codegen::CFGCodeGen generator(m_context, m_spmd_tutbl, pm.getWorkspace(),
+                                  m_file_writer);
+    for (auto record_decl : cfg.getRecords()) {
+        generator.emitRecord(record_decl);
+    }
+    generator.emit();
     return false;
 }
 
@@ -13,15 +13,15 @@ DEF_CFG_VISITOR(Compound, Stmt, cpmd) {
     for (auto stmt : cpmd->body()) {
         if (!TraverseStmt(stmt))
             continue;
-        STMT_COUNT(SRCDUMP(stmt), stmt->getStmtClassName());
+        STMT_COUNT(SRCSLICE(stmt), stmt->getStmtClassName());
     }
     return false;
 }
 
 DEF_CFG_VISITOR(Decl, Stmt, decl_stmt) {
     for (auto decl : decl_stmt->decls()) {
-        STMT_COUNT(SRCDUMP(decl), decl_stmt->getStmtClassName());
-        cfg::InternalNode *decl_node = new cfg::InternalNode(
+        STMT_COUNT(SRCSLICE(decl), decl_stmt->getStmtClassName());
+        cfg::InternalNode *decl_node = m_arena.create<cfg::InternalNode>(
             m_context, llvm::cast<const clang::VarDecl>(decl));
         m_curr_node = m_curr_node->splitEdge(decl_node);
     }
@@ -29,19 +29,20 @@ DEF_CFG_VISITOR(Decl, Stmt, decl_stmt) {
 }
 
 DEF_CFG_VISITOR(For, Stmt, for_stmt) {
-    STMT_COUNT(sourceDump(m_sm, m_lang_opts, for_stmt->getForLoc(),
-                          for_stmt->getRParenLoc()),
+    STMT_COUNT(sourceSlice(m_sm, m_lang_opts, for_stmt->getForLoc(),
+                           for_stmt->getRParenLoc()),
                for_stmt->getStmtClassName());
 
     // 1. Create for node
-    cfg::ForStmtNode *for_node = new cfg::ForStmtNode(m_context, for_stmt);
+    cfg::ForStmtNode *for_node =
+        m_arena.create<cfg::ForStmtNode>(m_context, for_stmt);
 
     // 2. Inserting for node
     m_curr_node->splitEdge(for_node);
     m_curr_node = for_node;
 
     // 3. Creating reconv node
-    cfg::ReconvNode *reconv = new cfg::ReconvNode(for_node);
+    cfg::ReconvNode *reconv = m_arena.create<cfg::ReconvNode>(for_node);
 
     // 4. Setting for's True to point to reconv
     for_node->splitEdge(reconv);
@@ -59,18 +60,19 @@ DEF_CFG_VISITOR(For, Stmt, for_stmt) {
 }
 
 DEF_CFG_VISITOR(If, Stmt, if_stmt) {
-    STMT_COUNT(sourceDump(m_sm, m_lang_opts, if_stmt->getBeginLoc(),
-                          if_stmt->getCond()->getEndLoc()),
+    STMT_COUNT(sourceSlice(m_sm, m_lang_opts, if_stmt->getBeginLoc(),
+                           if_stmt->getCond()->getEndLoc()),
                if_stmt->getStmtClassName());
     // 1. Creating if node
-    cfg::IfStmtNode *if_node = new cfg::IfStmtNode(m_context, if_stmt);
+    cfg::IfStmtNode *if_node =
+        m_arena.create<cfg::IfStmtNode>(m_context, if_stmt);
 
     // 2. Inserting if node
     m_curr_node->splitEdge(if_node);
     m_curr_node = if_node;
 
     // 3. Creating reconv node
-    cfg::ReconvNode *reconv = new cfg::ReconvNode(if_node);
+    cfg::ReconvNode *reconv = m_arena.create<cfg::ReconvNode>(if_node);
 
     // 4. Setting if's True to point to reconv
     if_node->splitEdge(reconv);
@@ -97,29 +99,32 @@ DEF_CFG_VISITOR(If, Stmt, if_stmt) {
 }
 
 DEF_CFG_VISITOR(Call, Expr, call) {
-    STMT_COUNT(SRCDUMP(call), call->getStmtClassName());
-    cfg::InternalNode *call_node = new cfg::InternalNode(m_context, call);
+    STMT_COUNT(SRCSLICE(call), call->getStmtClassName());
+    cfg::InternalNode *call_node =
+        m_arena.create<cfg::InternalNode>(m_context, call);
     m_curr_node->splitEdge(call_node);
     m_curr_node = call_node;
     return false;
 }
 
 DEF_CFG_VISITOR(PseudoObject, Expr, pseudo) { 
-    SPMDFY_ERROR("PseudoObjectExpr: {}", SRCDUMP(pseudo));
+    SPMDFY_ERROR("PseudoObjectExpr: {}", SRCSLICE(pseudo));
     return false; 
 }
 
 DEF_CFG_VISITOR(CompoundAssign, Operator, assgn) {
-    STMT_COUNT(SRCDUMP(assgn), assgn->getStmtClassName());
-    cfg::InternalNode *assgn_node = new cfg::InternalNode(m_context, assgn);
+    STMT_COUNT(SRCSLICE(assgn), assgn->getStmtClassName());
+    cfg::InternalNode *assgn_node =
+        m_arena.create<cfg::InternalNode>(m_context, assgn);
     m_curr_node->splitEdge(assgn_node);
     m_curr_node = assgn_node;
     return false;
 }
 
 DEF_CFG_VISITOR(Binary, Operator, binop) {
-    STMT_COUNT(SRCDUMP(binop), binop->getStmtClassName());
-    cfg::InternalNode *binop_node = new cfg::InternalNode(m_context, binop);
+    STMT_COUNT(SRCSLICE(binop), binop->getStmtClassName());
+    cfg::InternalNode *binop_node =
+        m_arena.create<cfg::InternalNode>(m_context, binop);
     m_curr_node->splitEdge(binop_node);
     m_curr_node = binop_node;
     return false;
@@ -129,8 +134,14 @@ auto ConstructSpmdCFG::get() -> std::vector<cfg::CFGNode *> {
     return m_spmdfy_tutbl;
 }
 
+auto ConstructSpmdCFG::getRecords()
+    -> std::vector<const clang::CXXRecordDecl *> {
+    return m_cpp_tutbl;
+}
+
 auto ConstructSpmdCFG::add(const clang::VarDecl *var_decl) -> bool {
-    m_spmdfy_tutbl.push_back(new cfg::GlobalVarNode(m_context, var_decl));
+    m_spmdfy_tutbl.push_back(
+        m_arena.create<cfg::GlobalVarNode>(m_context, var_decl));
     return true;
 }
 
@@ -159,9 +170,9 @@ auto ConstructSpmdCFG::splitEdge(cfg::CFGNode *node) -> bool {
 }
 
 auto ConstructSpmdCFG::add(const clang::FunctionDecl *func_decl) -> bool {
-    auto func = new cfg::KernelFuncNode(m_context, func_decl);
+    auto func = m_arena.create<cfg::KernelFuncNode>(m_context, func_decl);
     m_curr_node = func;
-    auto func_exit = new cfg::ExitNode();
+    auto func_exit = m_arena.create<cfg::ExitNode>();
     func->setNext(func_exit);
     func->setExit(func_exit);
     STMT_COUNT("Entry", "EntryNode");
@@ -172,7 +183,7 @@ auto ConstructSpmdCFG::add(const clang::FunctionDecl *func_decl) -> bool {
 }
 auto ConstructSpmdCFG::add(const clang::CXXRecordDecl *record_decl) -> bool {
     m_cpp_tutbl.push_back(record_decl);
-    return true;
+    return false;
 }
 
 } // namespace spmdfy
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include <spmdfy/CFG/CFG.hpp>
+#include <spmdfy/CommandLineOpts.hpp>
+#include <spmdfy/Generator/HostGenerator.hpp>
+#include <spmdfy/Logger.hpp>
+#include <spmdfy/utils.hpp>
+
+namespace spmdfy {
+
+/// \return true if the function only runs on the device, its body is
+/// transpiled to ISPC
+static auto isDeviceFunction(const clang::FunctionDecl *func_decl) -> bool {
+    return func_decl->hasAttr<clang::CUDAGlobalAttr>() ||
+           (func_decl->hasAttr<clang::CUDADeviceAttr>() &&
+            !func_decl->hasAttr<clang::CUDAHostAttr>());
+}
+
+/// \return the launch configuration without the implicit conversion to dim3
+/// and the copies clang inserts around it
+static auto skipDim3Conversion(const clang::Expr *expr)
+    -> const clang::Expr * {
+    while (true) {
+        expr = expr->IgnoreImplicit();
+        auto construct_expr = llvm::dyn_cast<clang::CXXConstructExpr>(expr);
+        if (!construct_expr || construct_expr->getNumArgs() == 0 ||
+            llvm::isa<clang::CXXTemporaryObjectExpr>(construct_expr) ||
+            construct_expr->getParenOrBraceRange().isValid()) {
+            return expr;
+        }
+        expr = construct_expr->getArg(0);
+    }
+}
+
+auto HostGenerator::handleTranslationUnit(clang::ASTContext &context)
+    -> bool {
+    for (const auto &header : host_includes) {
+        m_file_writer << "#include \"" << header << "\"\n";
+    }
+    TraverseDecl(context.getTranslationUnitDecl());
+    auto main_file = m_sm.getMainFileID();
+    if (auto buffer = m_rewriter.getRewriteBufferFor(main_file)) {
+        m_file_writer << std::string(buffer->begin(), buffer->end());
+    } else {
+        m_file_writer << m_sm.getBufferData(main_file);
+    }
+    return m_failed;
+}
+
+auto HostGenerator::TraverseFunctionDecl(clang::FunctionDecl *func_decl)
+    -> bool {
+    if (!isDeviceFunction(func_decl)) {
+        return RecursiveASTVisitor::TraverseFunctionDecl(func_decl);
+    }
+    // the declaration is kept, the host code may still name the kernel
+    auto body = func_decl->getBody();
+    if (body && func_decl->isThisDeclarationADefinition() &&
+        m_sm.isWrittenInMainFile(body->getBeginLoc()) &&
+        m_sm.isWrittenInMainFile(body->getEndLoc())) {
+        SPMDFY_INFO("Removing the body of {}", func_decl->getNameAsString());
+        m_rewriter.ReplaceText(body->getSourceRange(), ";");
+    }
+    return true;
+}
+
+auto HostGenerator::VisitCUDAKernelCallExpr(clang::CUDAKernelCallExpr *call)
+    -> bool {
+    auto begin = call->getBeginLoc();
+    if (!m_sm.isInMainFile(m_sm.getExpansionLoc(begin))) {
+        return true;
+    }
+    auto kernel = call->getDirectCallee();
+    auto config = call->getConfig();
+    if (begin.isMacroID() || call->getEndLoc().isMacroID() || !kernel ||
+        !config) {
+        llvm::errs() << "[SPMDFY] warning: " << begin.printToString(m_sm)
+                     << ": cannot rewrite a kernel launch "
+                     << (kernel ? "in a macro" : "of a dependent kernel")
+                     << "\n";
+        return true;
+    }
+    // the kernel takes the soa<> blocks of a struct laid out as SoA, the size
+    // of the host array which has to be converted is unknown here
+    for (auto param : kernel->parameters()) {
+        auto type = param->getType();
+        auto record_decl = type->isPointerType()
+                               ? type->getPointeeType()->getAsCXXRecordDecl()
+                               : nullptr;
+        if (record_decl && cfg::isSoARecord(record_decl)) {
+            std::string name = record_decl->getNameAsString();
+            llvm::errs() << "[SPMDFY] error: " << begin.printToString(m_sm)
+                         << ": cannot rewrite the launch of "
+                         << kernel->getNameAsString() << ", "
+                         << param->getNameAsString() << " is laid out as "
+                         << "soa<" << soa_width << "> " << name
+                         << ", convert the array with " << name
+                         << "_to_soa/" << name
+                         << "_from_soa and call the ISPC kernel\n";
+            m_failed = true;
+            return true;
+        }
+    }
+
+    // the launch is queued on its stream by spmdfy_runtime
+    auto getConfigArg = [&](unsigned arg) -> std::string {
+        if (config->getNumArgs() > arg &&
+            !llvm::isa<clang::CXXDefaultArgExpr>(config->getArg(arg))) {
+            return sourceDump(m_sm, m_lang_opts, config->getArg(arg));
+        }
+        return "0";
+    };
+    std::string launch = "spmdfyLaunchKernel(" + getConfigArg(3) +
+                         ", ispc::" + cfg::getKernelName(kernel) + ", " +
+                         getDim3(config->getArg(0)) + ", " +
+                         getDim3(config->getArg(1)) + ", " + getConfigArg(2);
+    for (auto arg : call->arguments()) {
+        if (auto default_arg = llvm::dyn_cast<clang::CXXDefaultArgExpr>(arg)) {
+            arg = default_arg->getExpr();
+        }
+        launch += ", " + sourceDump(m_sm, m_lang_opts, arg);
+    }
+    launch += ")";
+    SPMDFY_INFO("Rewriting launch of {} to {}", kernel->getNameAsString(),
+                launch);
+    m_rewriter.ReplaceText(call->getSourceRange(), launch);
+    return true;
+}
+
+auto HostGenerator::getDim3(const clang::Expr *expr) -> std::string {
+    expr = skipDim3Conversion(expr);
+    std::string dim = sourceDump(m_sm, m_lang_opts, expr);
+    if (expr->getType()->isIntegralOrEnumerationType()) {
+        return "ispc::Dim3{static_cast<int32_t>(" + dim + "), 1, 1}";
+    }
+    auto convert = [](const std::string &dim3) {
+        return "ispc::Dim3{static_cast<int32_t>(" + dim3 +
+               ".x), static_cast<int32_t>(" + dim3 +
+               ".y), static_cast<int32_t>(" + dim3 + ".z)}";
+    };
+    // the dim3 is evaluated once when reading it has side effects
+    if (expr->HasSideEffects(m_context)) {
+        return "[&] { const dim3 dim = " + dim + "; return " + convert("dim") +
+               "; }()";
+    }
+    if (!llvm::isa<clang::DeclRefExpr>(expr)) {
+        dim = "(" + dim + ")";
+    }
+    return convert(dim);
+}
+
+} // namespace spmdfy
@@ -4,23 +4,66 @@ namespace spmdfy {
 
 std::string ispc_macros = R"macro(
 #define ISPC_GRID_START                                                        \
-    Dim3 blockIdx, threadIdx;                                                  \
+    uniform Dim3 blockIdx;                                                     \
+    ThreadIdx threadIdx;                                                       \
     for (blockIdx.z = 0; blockIdx.z < gridDim.z; blockIdx.z++) {               \
         for (blockIdx.y = 0; blockIdx.y < gridDim.y; blockIdx.y++) {           \
             for (blockIdx.x = 0; blockIdx.x < gridDim.x; blockIdx.x++) {
 
+#define ISPC_TASK_GRID_START                                                   \
+    uniform Dim3 blockIdx;                                                     \
+    ThreadIdx threadIdx;                                                       \
+    blockIdx.x = taskIndex0;                                                   \
+    blockIdx.y = taskIndex1;                                                   \
+    blockIdx.z = taskIndex2;                                                   \
+    {
+
 #define ISPC_BLOCK_START                                                       \
     for (threadIdx.z = 0; threadIdx.z < blockDim.z; threadIdx.z++) {           \
         for (threadIdx.y = 0; threadIdx.y < blockDim.y; threadIdx.y++) {       \
-            for (threadIdx.x = programIndex; threadIdx.x < blockDim.x;         \
-                 threadIdx.x += programCount) {
+            for (uniform int threadBase = 0; threadBase < blockDim.x;          \
+                 threadBase += programCount) {                                 \
+                threadIdx.x = threadBase + programIndex;                       \
+                if (threadIdx.x < blockDim.x) {
+
+#define ISPC_IS_WARP_BLOCK                                                     \
+    (blockDim.x == programCount && blockDim.y == 1 && blockDim.z == 1)
+
+// the blockDim of a kernel specialized for a block size shadows the runtime
+// one, the block loops have constant trip counts and the tail mask folds away
+// when blockDim.x is a multiple of programCount
+#define ISPC_IS_BLOCK_DIM(X, Y, Z)                                             \
+    (blockDim.x == X && blockDim.y == Y && blockDim.z == Z)
+
+#define ISPC_FIXED_BLOCK_DIM(X, Y, Z) const uniform Dim3 blockDim = {X, Y, Z}
+
+#define ISPC_FIXED_BLOCK_START                                                 \
+    for (threadIdx.z = 0; threadIdx.z < blockDim.z; threadIdx.z++) {           \
+        for (threadIdx.y = 0; threadIdx.y < blockDim.y; threadIdx.y++) {       \
+            for (uniform int threadBase = 0; threadBase < blockDim.x;          \
+                 threadBase += programCount) {                                 \
+                threadIdx.x = threadBase + programIndex;                       \
+                if (blockDim.x % programCount == 0 ||                          \
+                    threadIdx.x < blockDim.x) {
+
+#define ISPC_WARP_BLOCK_START                                                  \
+    {                                                                          \
+        uniform int threadBase = 0;                                            \
+        threadIdx.z = 0;                                                       \
+        threadIdx.y = 0;                                                       \
+        threadIdx.x = programIndex;
+
+#define ISPC_WARP_BLOCK_END }
 
 #define ISPC_GRID_END                                                          \
     }                                                                          \
     }                                                                          \
     }
 
+#define ISPC_TASK_GRID_END }
+
 #define ISPC_BLOCK_END                                                         \
+    }                                                                          \
     }                                                                          \
     }                                                                          \
     }
@@ -42,9 +85,37 @@ std::string ispc_macros = R"macro(
         const uniform Dim3 &gridDim, const uniform Dim3 &blockDim,             \
         const uniform size_t &shared_memory_size, __VA_ARGS__)
 
+#define ISPC_TASK_KERNEL(function, ...)                                        \
+    task void function##_task(                                                 \
+        const uniform Dim3 gridDim, const uniform Dim3 blockDim,               \
+        const uniform size_t shared_memory_size, __VA_ARGS__)
+
+#define ISPC_TASK_LAUNCH(function, ...)                                        \
+    launch[gridDim.x, gridDim.y, gridDim.z] function##_task(                   \
+        gridDim, blockDim, shared_memory_size, __VA_ARGS__);                   \
+    sync
+
+// the body of a kernel owning heap buffers, a return in the body cannot skip
+// their release. The task indices are those of the task owning the buffers
+#define ISPC_KERNEL_BODY(function, ...)                                        \
+    static void function##_body(                                               \
+        const uniform Dim3 &gridDim, const uniform Dim3 &blockDim,             \
+        const uniform size_t &shared_memory_size,                              \
+        const uniform int taskIndex0, const uniform int taskIndex1,            \
+        const uniform int taskIndex2, __VA_ARGS__)
+
+#define ISPC_KERNEL_BODY_CALL(function, ...)                                   \
+    function##_body(gridDim, blockDim, shared_memory_size, 0, 0, 0,            \
+                    __VA_ARGS__)
+
+#define ISPC_TASK_BODY_CALL(function, ...)                                     \
+    function##_body(gridDim, blockDim, shared_memory_size, taskIndex0,         \
+                    taskIndex1, taskIndex2, __VA_ARGS__)
+
 #define ISPC_DEVICE_FUNCTION(rety, function, ...)                              \
     rety function(const uniform Dim3 &gridDim, const uniform Dim3 &blockDim,   \
-                  const Dim3 &blockIdx, const Dim3 &threadIdx, __VA_ARGS__)
+                  const uniform Dim3 &blockIdx, const ThreadIdx &threadIdx,    \
+                  __VA_ARGS__)
 
 #define ISPC_DEVICE_CALL(function, ...)                                        \
     function(gridDim, blockDim, blockIdx, threadIdx, __VA_ARGS__)
@@ -56,6 +127,285 @@ struct Dim3 {
     int x, y, z;
 };
 
+// only threadIdx.x varies across the gang, threadIdx.y and threadIdx.z are
+// the counters of the uniform block loops
+struct ThreadIdx {
+    int x;
+    uniform int y;
+    uniform int z;
+};
+
+// a warp is mapped onto the gang, warp synchronous code sees warpSize lanes
+#define warpSize programCount
+
+// CUDA shuffles return the own value of a lane whose source lies outside of
+// its segment of width lanes
+#define SPMDFY_WARP_SHUFFLE(T)                                                 \
+    static inline T __spmdfy_shfl(T var, int src_lane, uniform int width) {    \
+        uniform int w = min(width, programCount);                              \
+        return shuffle(var, (programIndex & ~(w - 1)) + (src_lane & (w - 1))); \
+    }                                                                          \
+    static inline T __spmdfy_shfl_up(T var, uniform int delta,                 \
+                                     uniform int width) {                      \
+        uniform int w = min(width, programCount);                              \
+        T rotated = rotate(var, -delta);                                       \
+        return (programIndex & (w - 1)) >= delta ? rotated : var;              \
+    }                                                                          \
+    static inline T __spmdfy_shfl_down(T var, uniform int delta,               \
+                                       uniform int width) {                    \
+        uniform int w = min(width, programCount);                              \
+        T rotated = rotate(var, delta);                                        \
+        return (programIndex & (w - 1)) + delta < w ? rotated : var;           \
+    }                                                                          \
+    static inline T __spmdfy_shfl_xor(T var, int lane_mask,                    \
+                                      uniform int width) {                     \
+        uniform int w = min(width, programCount);                              \
+        int lane = programIndex ^ lane_mask;                                   \
+        T shuffled = shuffle(var, lane & (programCount - 1));                  \
+        return (lane & ~(w - 1)) == (programIndex & ~(w - 1)) ? shuffled       \
+                                                              : var;           \
+    }
+
+SPMDFY_WARP_SHUFFLE(int32)
+SPMDFY_WARP_SHUFFLE(unsigned int32)
+SPMDFY_WARP_SHUFFLE(int64)
+SPMDFY_WARP_SHUFFLE(unsigned int64)
+SPMDFY_WARP_SHUFFLE(float)
+SPMDFY_WARP_SHUFFLE(double)
+
+// the gang runs in lockstep
+static inline void __syncwarp() {}
+static inline void __syncwarp(uniform unsigned int32 mask) {}
+
+// CUDA math functions without an ISPC counterpart, see docs/math.rst for
+// their accuracy. The _fast variants are used with --fast-math
+#define SPMDFY_LN2 0.693147180559945309417d
+#define SPMDFY_LN10 2.302585092994045684018d
+#define SPMDFY_LOG2E 1.442695040888963407360d
+#define SPMDFY_LOG10E 0.434294481903251827651d
+#define SPMDFY_PI 3.141592653589793238463d
+#define SPMDFY_2_SQRTPI 1.128379167095512573896d
+#define SPMDFY_SQRT1_2 0.707106781186547524401d
+
+#define SPMDFY_MATH_FUNCTIONS(T)                                               \
+    static inline T __spmdfy_trunc(T x) {                                      \
+        return x < 0 ? ceil(x) : floor(x);                                     \
+    }                                                                          \
+    static inline T __spmdfy_round(T x) {                                      \
+        T t = __spmdfy_trunc(x);                                               \
+        return abs(x - t) >= 0.5 ? t + (x < 0 ? -1 : 1) : t;                   \
+    }                                                                          \
+    static inline T __spmdfy_copysign(T x, T y) {                              \
+        return signbits(y) != 0 ? -abs(x) : abs(x);                            \
+    }                                                                          \
+    static inline T __spmdfy_fdim(T x, T y) { return x > y ? x - y : 0; }      \
+    static inline T __spmdfy_fma(T x, T y, T z) { return x * y + z; }          \
+    static inline T __spmdfy_fmod(T x, T y) {                                  \
+        return x - __spmdfy_trunc(x / y) * y;                                  \
+    }                                                                          \
+    static inline T __spmdfy_saturate(T x) { return clamp(x, (T)0, (T)1); }    \
+    static inline T __spmdfy_rsqrt(T x) { return 1 / sqrt(x); }                \
+    static inline T __spmdfy_rcp(T x) { return 1 / x; }                        \
+    static inline T __spmdfy_fdivide(T x, T y) { return x * rcp(y); }          \
+    static inline T __spmdfy_exp2(T x) {                                       \
+        T n = round(clamp(x, (T)-2100, (T)2100));                              \
+        return ldexp(exp((x - n) * (T)SPMDFY_LN2), (int)n);                    \
+    }                                                                          \
+    static inline T __spmdfy_exp10(T x) { return exp(x * (T)SPMDFY_LN10); }    \
+    static inline T __spmdfy_log2(T x) { return log(x) * (T)SPMDFY_LOG2E; }    \
+    static inline T __spmdfy_log10(T x) { return log(x) * (T)SPMDFY_LOG10E; }  \
+    static inline T __spmdfy_sinpi(T x) { return sin(x * (T)SPMDFY_PI); }      \
+    static inline T __spmdfy_cospi(T x) { return cos(x * (T)SPMDFY_PI); }      \
+    static inline T __spmdfy_log1p(T x) {                                      \
+        T u = 1 + x;                                                           \
+        if (u == 1) {                                                          \
+            return x;                                                          \
+        }                                                                      \
+        return abs(x) < 0.5 ? log(u) * (x / (u - 1)) : log(u);                 \
+    }                                                                          \
+    static inline T __spmdfy_expm1(T x) {                                      \
+        T u = exp(x);                                                          \
+        if (u == 1) {                                                          \
+            return x;                                                          \
+        }                                                                      \
+        return abs(x) < 0.5 ? (u - 1) * (x / log(u)) : u - 1;                  \
+    }                                                                          \
+    static inline T __spmdfy_asinh(T x) {                                      \
+        T a = abs(x);                                                          \
+        T r = a > (T)268435456                                                 \
+                  ? log(a) + (T)SPMDFY_LN2                                     \
+                  : __spmdfy_log1p(a + a * a / (1 + sqrt(1 + a * a)));         \
+        return __spmdfy_copysign(r, x);                                        \
+    }                                                                          \
+    static inline T __spmdfy_acosh(T x) {                                      \
+        T t = x - 1;                                                           \
+        return x > (T)268435456 ? log(x) + (T)SPMDFY_LN2                       \
+                                : __spmdfy_log1p(t + sqrt(2 * t + t * t));     \
+    }                                                                          \
+    static inline T __spmdfy_atanh(T x) {                                      \
+        return 0.5 * __spmdfy_log1p(2 * x / (1 - x));                          \
+    }                                                                          \
+    static inline T __spmdfy_sinh(T x) {                                       \
+        T a = abs(x);                                                          \
+        T e = __spmdfy_expm1(a);                                               \
+        T r = a < 1 ? 0.5 * (e + e / (e + 1)) : 0.5 * (e + 1 - 1 / (e + 1));   \
+        return __spmdfy_copysign(r, x);                                        \
+    }                                                                          \
+    static inline T __spmdfy_cosh(T x) {                                       \
+        T u = exp(abs(x));                                                     \
+        return 0.5 * (u + 1 / u);                                              \
+    }                                                                          \
+    static inline T __spmdfy_tanh(T x) {                                       \
+        T e = __spmdfy_expm1(-2 * abs(x));                                     \
+        return __spmdfy_copysign(-e / (e + 2), x);                             \
+    }                                                                          \
+    static inline T __spmdfy_cbrt(T x) {                                       \
+        T a = abs(x);                                                          \
+        if (a == 0 || a * 0 != 0) {                                            \
+            return x;                                                          \
+        }                                                                      \
+        T r = pow(a, (T)(1.d / 3.d));                                          \
+        r = r - (r * r * r - a) / (3 * r * r);                                 \
+        return __spmdfy_copysign(r, x);                                        \
+    }                                                                          \
+    static inline T __spmdfy_rcbrt(T x) { return 1 / __spmdfy_cbrt(x); }       \
+    static inline T __spmdfy_hypot(T x, T y) {                                 \
+        T a = max(abs(x), abs(y));                                             \
+        if (a == 0 || a * 0 != 0) {                                            \
+            return a;                                                          \
+        }                                                                      \
+        T q = min(abs(x), abs(y)) / a;                                         \
+        return a * sqrt(1 + q * q);                                            \
+    }                                                                          \
+    static inline T __spmdfy_erfc(T x) {                                       \
+        T z = abs(x);                                                          \
+        T t = 1 / (1 + (T)0.5d * z);                                           \
+        T p = (T)-0.82215223d + t * (T)0.17087277d;                            \
+        p = (T)1.48851587d + t * p;                                            \
+        p = (T)-1.13520398d + t * p;                                           \
+        p = (T)0.27886807d + t * p;                                            \
+        p = (T)-0.18628806d + t * p;                                           \
+        p = (T)0.09678418d + t * p;                                            \
+        p = (T)0.37409196d + t * p;                                            \
+        p = (T)1.00002368d + t * p;                                            \
+        T r = t * exp(-z * z - (T)1.26551223d + t * p);                        \
+        return x < 0 ? 2 - r : r;                                              \
+    }                                                                          \
+    static inline T __spmdfy_erf(T x) {                                        \
+        if (abs(x) >= 0.5) {                                                   \
+            return __spmdfy_copysign(1 - __spmdfy_erfc(abs(x)), x);            \
+        }                                                                      \
+        T x2 = x * x;                                                          \
+        T p = (T)(-1.d / 1320.d) + x2 * (T)(1.d / 9360.d);                     \
+        p = (T)(1.d / 216.d) + x2 * p;                                         \
+        p = (T)(-1.d / 42.d) + x2 * p;                                         \
+        p = (T)(1.d / 10.d) + x2 * p;                                          \
+        p = (T)(-1.d / 3.d) + x2 * p;                                          \
+        return x * (T)SPMDFY_2_SQRTPI * (1 + x2 * p);                          \
+    }                                                                          \
+    static inline T __spmdfy_normcdf(T x) {                                    \
+        return 0.5 * __spmdfy_erfc(-x * (T)SPMDFY_SQRT1_2);                    \
+    }                                                                          \
+    static inline int64 __spmdfy_lrint(T x) { return (int64)round(x); }        \
+    static inline int64 __spmdfy_lround(T x) {                                 \
+        return (int64)__spmdfy_round(x);                                       \
+    }                                                                          \
+    static inline T __spmdfy_log1p_fast(T x) { return log(1 + x); }            \
+    static inline T __spmdfy_expm1_fast(T x) { return exp(x) - 1; }            \
+    static inline T __spmdfy_asinh_fast(T x) {                                 \
+        T a = abs(x);                                                          \
+        return __spmdfy_copysign(log(a + sqrt(a * a + 1)), x);                 \
+    }                                                                          \
+    static inline T __spmdfy_acosh_fast(T x) {                                 \
+        return log(x + sqrt(x * x - 1));                                       \
+    }                                                                          \
+    static inline T __spmdfy_atanh_fast(T x) {                                 \
+        return 0.5 * log((1 + x) / (1 - x));                                   \
+    }                                                                          \
+    static inline T __spmdfy_sinh_fast(T x) {                                  \
+        T u = exp(x);                                                          \
+        return 0.5 * (u - 1 / u);                                              \
+    }                                                                          \
+    static inline T __spmdfy_tanh_fast(T x) {                                  \
+        return 1 - 2 / (exp(2 * x) + 1);                                       \
+    }                                                                          \
+    static inline T __spmdfy_cbrt_fast(T x) {                                  \
+        return __spmdfy_copysign(pow(abs(x), (T)(1.d / 3.d)), x);              \
+    }                                                                          \
+    static inline T __spmdfy_rcbrt_fast(T x) {                                 \
+        return __spmdfy_copysign(pow(abs(x), (T)(-1.d / 3.d)), x);             \
+    }                                                                          \
+    static inline T __spmdfy_hypot_fast(T x, T y) {                            \
+        return sqrt(x * x + y * y);                                            \
+    }
+
+SPMDFY_MATH_FUNCTIONS(float)
+SPMDFY_MATH_FUNCTIONS(double)
+
+static inline int __spmdfy_ffs(int32 i) {
+    return i != 0 ? count_trailing_zeros(i) + 1 : 0;
+}
+static inline int __spmdfy_ffs(int64 i) {
+    return i != 0 ? (int)count_trailing_zeros(i) + 1 : 0;
+}
+
+// CUDA vector types are ISPC short vectors, which come with the member-wise
+// operators and the .x, .y, .z and .w members
+#define SPMDFY_MAKE_VECTOR(T, NAME)                                            \
+    static inline T<2> make_##NAME##2(T x, T y) {                              \
+        T<2> v = {x, y};                                                       \
+        return v;                                                              \
+    }                                                                          \
+    static inline T<3> make_##NAME##3(T x, T y, T z) {                         \
+        T<3> v = {x, y, z};                                                    \
+        return v;                                                              \
+    }                                                                          \
+    static inline T<4> make_##NAME##4(T x, T y, T z, T w) {                    \
+        T<4> v = {x, y, z, w};                                                 \
+        return v;                                                              \
+    }
+
+SPMDFY_MAKE_VECTOR(int8, char)
+SPMDFY_MAKE_VECTOR(unsigned int8, uchar)
+SPMDFY_MAKE_VECTOR(int16, short)
+SPMDFY_MAKE_VECTOR(unsigned int16, ushort)
+SPMDFY_MAKE_VECTOR(int32, int)
+SPMDFY_MAKE_VECTOR(unsigned int32, uint)
+SPMDFY_MAKE_VECTOR(int64, long)
+SPMDFY_MAKE_VECTOR(unsigned int64, ulong)
+SPMDFY_MAKE_VECTOR(int64, longlong)
+SPMDFY_MAKE_VECTOR(unsigned int64, ulonglong)
+SPMDFY_MAKE_VECTOR(float, float)
+SPMDFY_MAKE_VECTOR(double, double)
+
+// the consecutive vectors of the gang are accessed with wide loads and stores
+// and deinterleaved when every program instance of the gang is active, the
+// load casts the const away as aos_to_soa4 does not take a pointer to const
+#define SPMDFY_WIDE_VECTOR4(T, S)                                              \
+    static inline T<4> __spmdfy_load4(const uniform T<4> a[],                  \
+                                      uniform int base) {                      \
+        if (popcnt(lanemask()) != programCount) {                              \
+            return a[base + programIndex];                                     \
+        }                                                                      \
+        S x, y, z, w;                                                          \
+        aos_to_soa4((uniform S *uniform)&a[base], &x, &y, &z, &w);             \
+        T<4> v = {x, y, z, w};                                                 \
+        return v;                                                              \
+    }                                                                          \
+    static inline void __spmdfy_store4(uniform T<4> a[], uniform int base,     \
+                                       T<4> v) {                               \
+        if (popcnt(lanemask()) != programCount) {                              \
+            a[base + programIndex] = v;                                        \
+            return;                                                            \
+        }                                                                      \
+        soa_to_aos4((S)v.x, (S)v.y, (S)v.z, (S)v.w,                            \
+                    (uniform S *uniform)&a[base]);                             \
+    }
+
+SPMDFY_WIDE_VECTOR4(float, float)
+SPMDFY_WIDE_VECTOR4(int32, int32)
+SPMDFY_WIDE_VECTOR4(unsigned int32, int32)
+
 )macro";
 
 }
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include <spmdfy/Logger.hpp>
+#include <spmdfy/OutputCache.hpp>
+
+// clang headers
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Lex/PPCallbacks.h>
+#include <clang/Lex/Preprocessor.h>
+
+// llvm headers
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/raw_ostream.h>
+
+// standard headers
+#include <set>
+
+namespace spmdfy {
+
+/// records every file entered by the preprocessor in the order of inclusion
+class EnteredFilesCollector : public clang::PPCallbacks {
+  public:
+    EnteredFilesCollector(
+        clang::SourceManager &sm,
+        std::vector<std::pair<clang::FileID, bool>> &entered_files)
+        : m_sm(sm), m_entered_files(entered_files) {}
+
+    void FileChanged(clang::SourceLocation loc, FileChangeReason reason,
+                     clang::SrcMgr::CharacteristicKind file_type,
+                     clang::FileID prev_fid) override {
+        if (reason != EnterFile) {
+            return;
+        }
+        m_entered_files.emplace_back(m_sm.getFileID(m_sm.getExpansionLoc(loc)),
+                                     clang::SrcMgr::isSystem(file_type));
+    }
+
+  private:
+    clang::SourceManager &m_sm;
+    std::vector<std::pair<clang::FileID, bool>> &m_entered_files;
+};
+
+auto HashPreprocessedAction::ExecuteAction() -> void {
+    clang::CompilerInstance &ci = getCompilerInstance();
+    clang::Preprocessor &pp = ci.getPreprocessor();
+    clang::SourceManager &sm = ci.getSourceManager();
+
+    std::vector<std::pair<clang::FileID, bool>> entered_files;
+    pp.addPPCallbacks(
+        llvm::make_unique<EnteredFilesCollector>(sm, entered_files));
+
+    // preprocessing the whole TU discovers the includes guarded by macros
+    clang::Token token;
+    pp.EnterMainSourceFile();
+    do {
+        pp.Lex(token);
+    } while (token.isNot(clang::tok::eof));
+
+    // Hashing the contents instead of the token stream keeps the comments and
+    // the layout which sourceDump copies into the generated code
+    std::set<const clang::FileEntry *> hashed;
+    for (const auto &[fid, is_system] : entered_files) {
+        const clang::FileEntry *entry = sm.getFileEntryForID(fid);
+        if (!entry || !hashed.insert(entry).second) {
+            continue;
+        }
+        bool invalid = false;
+        llvm::StringRef contents = sm.getBufferData(fid, &invalid);
+        if (invalid) {
+            continue;
+        }
+        m_hash.update(entry->getName());
+        m_hash.update(contents);
+        if (!is_system) {
+            m_dependencies.push_back(entry->getName());
+        }
+    }
+}
+
+auto HashPreprocessedActionFactory::create() -> clang::FrontendAction * {
+    return new HashPreprocessedAction(m_hash, m_dependencies);
+}
+
+namespace cache {
+
+static auto getEntryPath(llvm::StringRef cache_dir, llvm::StringRef key)
+    -> std::string {
+    llvm::SmallString<256> entry(cache_dir);
+    llvm::sys::path::append(entry, key + ".ispc");
+    return entry.str();
+}
+
+bool lookup(llvm::StringRef cache_dir, llvm::StringRef key,
+            llvm::StringRef output) {
+    std::string entry = getEntryPath(cache_dir, key);
+    if (!llvm::sys::fs::exists(entry)) {
+        return false;
+    }
+    if (auto error_code = llvm::sys::fs::copy_file(entry, output)) {
+        SPMDFY_ERROR("Unable to reuse cached {}: {}", entry,
+                     error_code.message());
+        return false;
+    }
+    SPMDFY_INFO("Reusing cached {}", entry);
+    return true;
+}
+
+void store(llvm::StringRef cache_dir, llvm::StringRef key,
+           llvm::StringRef output) {
+    if (auto error_code = llvm::sys::fs::create_directories(cache_dir)) {
+        SPMDFY_ERROR("Unable to create cache {}: {}", cache_dir.str(),
+                     error_code.message());
+        return;
+    }
+    llvm::SmallString<256> temp_model(cache_dir);
+    llvm::sys::path::append(temp_model, key + "-%%%%%%.tmp");
+    llvm::SmallString<256> temp_path;
+    int temp_fd;
+    if (llvm::sys::fs::createUniqueFile(temp_model, temp_fd, temp_path)) {
+        return;
+    }
+    llvm::sys::Process::SafelyCloseFileDescriptor(temp_fd);
+    if (llvm::sys::fs::copy_file(output, temp_path) ||
+        llvm::sys::fs::rename(temp_path, getEntryPath(cache_dir, key))) {
+        llvm::sys::fs::remove(temp_path);
+    }
+}
+
+/// escapes the characters make treats specially in a prerequisite
+static auto escapeDepfilePath(llvm::StringRef path) -> std::string {
+    std::string escaped;
+    for (char c : path) {
+        if (c == ' ' || c == '#') {
+            escaped += '\\';
+        } else if (c == '$') {
+            escaped += '$';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+bool writeDepfile(llvm::StringRef depfile, llvm::StringRef target,
+                  const std::vector<std::string> &dependencies) {
+    std::error_code error_code;
+    llvm::raw_fd_ostream out(depfile, error_code, llvm::sys::fs::F_Text);
+    if (error_code) {
+        SPMDFY_ERROR("Unable to write depfile {}: {}", depfile.str(),
+                     error_code.message());
+        return true;
+    }
+    out << escapeDepfilePath(target) << ":";
+    for (const auto &dependency : dependencies) {
+        out << " \\\n  " << escapeDepfilePath(dependency);
+    }
+    out << "\n";
+    return false;
+}
+
+} // namespace cache
+} // namespace spmdfy
@@ -0,0 +1,213 @@
+#include <spmdfy/Logger.hpp>
+#include <spmdfy/PCHCache.hpp>
+
+// clang headers
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Tooling/Tooling.h>
+
+// llvm headers
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+// standard headers
+#include <algorithm>
+#include <array>
+
+namespace spmdfy {
+
+auto GenerateStampedPCHAction::BeginInvocation(clang::CompilerInstance &ci)
+    -> bool {
+    ci.getFrontendOpts().OutputFile = m_pch_path;
+    return clang::GeneratePCHAction::BeginInvocation(ci);
+}
+
+auto GenerateStampedPCHAction::EndSourceFileAction() -> void {
+    clang::GeneratePCHAction::EndSourceFileAction();
+    std::error_code error_code;
+    llvm::raw_fd_ostream stamp(m_pch_path + ".stamp", error_code,
+                               llvm::sys::fs::F_Text);
+    if (error_code) {
+        return;
+    }
+    clang::SourceManager &sm = getCompilerInstance().getSourceManager();
+    for (auto file = sm.fileinfo_begin(); file != sm.fileinfo_end(); file++) {
+        const clang::FileEntry *entry = file->first;
+        stamp << entry->getSize() << " " << entry->getModificationTime() << " "
+              << entry->getName() << "\n";
+    }
+}
+
+/// \return true if every input file recorded in the stamp of the PCH is
+/// unchanged on disk
+static auto isStampValid(const std::string &pch_path) -> bool {
+    if (!llvm::sys::fs::exists(pch_path)) {
+        return false;
+    }
+    auto stamp = llvm::MemoryBuffer::getFile(pch_path + ".stamp");
+    if (!stamp) {
+        return false;
+    }
+    llvm::SmallVector<llvm::StringRef, 256> lines;
+    (*stamp)->getBuffer().split(lines, '\n', -1, false);
+    for (auto line : lines) {
+        llvm::StringRef size, mtime, name;
+        std::tie(size, line) = line.split(' ');
+        std::tie(mtime, name) = line.split(' ');
+        llvm::sys::fs::file_status status;
+        if (llvm::sys::fs::status(name, status) ||
+            std::to_string(status.getSize()) != size ||
+            std::to_string(llvm::sys::toTimeT(
+                status.getLastModificationTime())) != mtime) {
+            SPMDFY_INFO("PCH input {} changed", name.str());
+            return false;
+        }
+    }
+    return true;
+}
+
+/// \return number of arguments starting at arg which affect the preprocessed
+/// headers or the language options of the PCH, 0 if the argument is specific
+/// to the compiled file(-o, -c, -MF, ...)
+static auto getHeaderArgCount(const std::vector<std::string> &args, size_t arg)
+    -> size_t {
+    static const std::array<llvm::StringRef, 13> separate = {
+        "-I",        "-D",         "-U",          "-include",
+        "-imacros",  "-isystem",   "-iquote",     "-idirafter",
+        "-isysroot", "-target",    "-Xclang",     "--cuda-path",
+        "--cuda-gpu-arch"};
+    // -f, -m and -O change the language options and the predefined macros
+    static const std::array<llvm::StringRef, 17> joined = {
+        "-I",         "-D",        "-U",        "-std=",
+        "-include",   "-imacros",  "-isystem",  "-iquote",
+        "-idirafter", "-isysroot", "--sysroot", "--target=",
+        "--cuda-",    "-nostdinc", "-f",        "-m",
+        "-O"};
+    llvm::StringRef value(args[arg]);
+    if (std::find(separate.begin(), separate.end(), value) != separate.end()) {
+        return arg + 1 < args.size() ? 2 : 1;
+    }
+    if (std::any_of(joined.begin(), joined.end(), [&](llvm::StringRef prefix) {
+            return value.startswith(prefix);
+        })) {
+        return 1;
+    }
+    return 0;
+}
+
+PCHCache::PCHCache(const std::string &cache_dir, std::string options_key)
+    : m_cache_dir(cache_dir), m_options_key(std::move(options_key)) {
+    // the PCH refers to its inputs by path, they must resolve from any
+    // working directory
+    llvm::SmallString<256> absolute_dir(cache_dir);
+    if (!llvm::sys::fs::make_absolute(absolute_dir)) {
+        m_cache_dir = absolute_dir.str();
+    }
+}
+
+auto PCHCache::buildPCH(
+    const std::string &pch_path, const std::vector<std::string> &command_line,
+    const clang::tooling::ArgumentsAdjuster &adjuster,
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> file_system) -> bool {
+    using namespace clang::tooling;
+    if (auto error_code = llvm::sys::fs::create_directories(m_cache_dir)) {
+        llvm::errs() << "[SPMDFY] error: " << error_code.message() << ": "
+                     << m_cache_dir << "\n";
+        return true;
+    }
+
+    // the driver includes the CUDA wrapper headers implicitly, an empty source
+    // precompiles exactly them. It is kept on disk as clang validates the
+    // source of a PCH when loading it
+    llvm::SmallString<256> pch_source(m_cache_dir);
+    llvm::sys::path::append(pch_source, "spmdfy_cuda_wrappers.cu");
+    if (!llvm::sys::fs::exists(pch_source)) {
+        std::error_code error_code;
+        llvm::raw_fd_ostream empty_source(pch_source, error_code);
+    }
+
+    FixedCompilationDatabase compilations(".", command_line);
+    ClangTool tool(compilations, {pch_source.str()},
+                   std::make_shared<clang::PCHContainerOperations>(),
+                   file_system);
+    tool.appendArgumentsAdjuster(adjuster);
+
+    // built next to the final path and renamed so that concurrent spmdfy
+    // invocations never load a partial PCH
+    llvm::SmallString<256> temp_path;
+    if (llvm::sys::fs::createUniqueFile(pch_path + "-%%%%%%.tmp", temp_path)) {
+        return true;
+    }
+    std::string temp_pch = temp_path.str();
+
+    struct Factory : public FrontendActionFactory {
+        explicit Factory(std::string pch_path) : pch_path(pch_path) {}
+        auto create() -> clang::FrontendAction * override {
+            return new GenerateStampedPCHAction(pch_path);
+        }
+        std::string pch_path;
+    } action(temp_pch);
+
+    SPMDFY_INFO("Building PCH {}", pch_path);
+    if (tool.run(&action) ||
+        llvm::sys::fs::rename(temp_pch + ".stamp", pch_path + ".stamp") ||
+        llvm::sys::fs::rename(temp_pch, pch_path)) {
+        llvm::sys::fs::remove(temp_pch);
+        llvm::sys::fs::remove(temp_pch + ".stamp");
+        return true;
+    }
+    return false;
+}
+
+auto PCHCache::getPCH(
+    const clang::tooling::CompilationDatabase &compilations,
+    const std::string &src, const clang::tooling::ArgumentsAdjuster &adjuster,
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> file_system)
+    -> std::string {
+    auto commands = compilations.getCompileCommands(src);
+    if (commands.size() != 1) {
+        return "";
+    }
+
+    // the arguments of the compile command which affect the headers, the
+    // sources sharing them share the PCH
+    const std::vector<std::string> &args = commands[0].CommandLine;
+    std::vector<std::string> command_line;
+    llvm::MD5 hash;
+    hash.update(m_options_key);
+    for (size_t i = 1; i < args.size();) {
+        size_t count = getHeaderArgCount(args, i);
+        if (count == 0) {
+            i++;
+            continue;
+        }
+        for (; count > 0; count--, i++) {
+            command_line.push_back(args[i]);
+            // separates the arguments in the hash, -I a -D b from -Ia -Db
+            hash.update(args[i]);
+            hash.update(llvm::StringRef("", 1));
+        }
+    }
+    llvm::MD5::MD5Result hash_result;
+    hash.final(hash_result);
+    llvm::SmallString<256> pch_path(m_cache_dir);
+    llvm::sys::path::append(pch_path, hash_result.digest() + ".pch");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto pch = m_pchs.find(pch_path.str());
+    if (pch != m_pchs.end()) {
+        return pch->second;
+    }
+    if (!isStampValid(pch_path.str()) &&
+        buildPCH(pch_path.str(), command_line, adjuster, file_system)) {
+        llvm::errs() << "[SPMDFY] warning: unable to build PCH " << pch_path
+                     << ", parsing the CUDA headers\n";
+        return m_pchs[pch_path.str()] = "";
+    }
+    return m_pchs[pch_path.str()] = pch_path.str();
+}
+
+} // namespace spmdfy
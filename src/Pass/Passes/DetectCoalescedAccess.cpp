@@ -0,0 +1,358 @@
+#include <spmdfy/Pass/Passes/DetectCoalescedAccess.hpp>
+#include <spmdfy/Pass/Passes/InferUniformNodes.hpp>
+
+#include <clang/Rewrite/Core/Rewriter.h>
+
+#include <optional>
+
+namespace spmdfy {
+
+namespace pass {
+
+bool isThreadIdxX(const clang::Expr *expr) {
+    expr = expr->IgnoreParenImpCasts();
+    if (auto pseudo = llvm::dyn_cast<clang::PseudoObjectExpr>(expr)) {
+        expr = pseudo->getSyntacticForm();
+    }
+    auto property = llvm::dyn_cast<clang::MSPropertyRefExpr>(expr);
+    if (!property || property->getPropertyDecl()->getName() != "x") {
+        return false;
+    }
+    auto base = llvm::dyn_cast<clang::DeclRefExpr>(
+        property->getBaseExpr()->IgnoreParenImpCasts());
+    return base && base->getDecl()->getName() == "threadIdx" &&
+           !base->getDecl()->getParentFunctionOrMethod();
+}
+
+/**
+ * Proves that array indices are of the affine form uniform_base + threadIdx.x
+ * i.e. consecutive program instances access consecutive elements. The uniform
+ * base is recorded as source text so the codegen can rewrite the index
+ * relative to programIndex. The local variables of the base are replaced by
+ * their initializers, the text is pasted into regions where they may not be
+ * declared.
+ * */
+class DetectCoalesced {
+  public:
+    DetectCoalesced(clang::ASTContext &ast_context, Workspace &workspace)
+        : m_ast_context(ast_context), m_sm(ast_context.getSourceManager()),
+          m_lang_opts(ast_context.getLangOpts()), m_workspace(workspace) {
+        m_lang_opts.CPlusPlus = true;
+        m_lang_opts.Bool = true;
+    }
+
+    auto run(cfg::KernelFuncNode *kernel) -> void {
+        if (!kernel->getKernelNode()->hasAttr<clang::CUDAGlobalAttr>()) {
+            return;
+        }
+        // 1. Collecting every variable that is written after its declaration
+        m_collect = true;
+        walk(kernel->getNext(), [this](const clang::Stmt *stmt) {
+            collectAssigned(stmt);
+        });
+        for (auto var_decl : m_workspace.uniform_vars) {
+            if (!m_assigned.count(var_decl)) {
+                m_stable.insert(var_decl);
+            }
+        }
+
+        // 2. Detecting affine variables and coalesced subscripts in order
+        m_collect = false;
+        walk(kernel->getNext(), [this](const clang::Stmt *stmt) {
+            collectSubscripts(stmt);
+        });
+    }
+
+  private:
+    template <typename Fn> auto walk(cfg::CFGNode *node, Fn &&fn) -> void {
+        for (auto curr_node = node; !ISNODE(curr_node, cfg::CFGNode::Reconv) &&
+                                    !ISNODE(curr_node, cfg::CFGNode::Exit);
+             curr_node = curr_node->getNext()) {
+            switch (curr_node->getNodeType()) {
+            case cfg::CFGNode::Internal: {
+                auto internal = llvm::cast<cfg::InternalNode>(curr_node);
+                std::visit(
+                    Overload{[&](const clang::Decl *decl) {
+                                 handleDecl(decl, fn);
+                             },
+                             [&](const clang::Stmt *stmt) { fn(stmt); },
+                             [&](const clang::Expr *expr) { fn(expr); },
+                             [](const clang::Type *) {}},
+                    internal->getInternalNode());
+                break;
+            }
+            case cfg::CFGNode::IfStmt: {
+                auto if_node = llvm::cast<cfg::IfStmtNode>(curr_node);
+                fn(if_node->getIfStmt()->getCond());
+                walk(if_node->getTrueBlock(), fn);
+                walk(if_node->getFalseBlock(), fn);
+                curr_node = if_node->getReconv();
+                break;
+            }
+            case cfg::CFGNode::ForStmt: {
+                auto for_node = llvm::cast<cfg::ForStmtNode>(curr_node);
+                auto for_stmt = for_node->getForStmt();
+                if (for_stmt->getInit()) {
+                    fn(for_stmt->getInit());
+                }
+                if (for_stmt->getInc()) {
+                    fn(for_stmt->getInc());
+                }
+                walk(for_node->getNext(), fn);
+                curr_node = for_node->getReconv();
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+
+    template <typename Fn>
+    auto handleDecl(const clang::Decl *decl, Fn &&fn) -> void {
+        auto var_decl = llvm::dyn_cast<clang::VarDecl>(decl);
+        if (!var_decl || !var_decl->getInit()) {
+            return;
+        }
+        fn(var_decl->getInit());
+        if (m_collect && isMutableReference(var_decl->getType())) {
+            if (auto bound = getVarDecl(var_decl->getInit())) {
+                m_assigned.insert(bound);
+            }
+        }
+        if (m_collect || m_assigned.count(var_decl) ||
+            !var_decl->isLocalVarDecl() ||
+            var_decl->hasAttr<clang::CUDASharedAttr>()) {
+            return;
+        }
+        if (auto base = getAffineBase(var_decl->getInit()); base) {
+            SPMDFY_INFO("[DetectCoalescedAccess] {} = ({}) + threadIdx.x",
+                        var_decl->getNameAsString(), *base);
+            m_affine_vars[var_decl] = *base;
+        }
+    }
+
+    auto getVarDecl(const clang::Expr *expr) -> const clang::VarDecl * {
+        expr = expr->IgnoreParenImpCasts();
+        if (auto decl_ref = llvm::dyn_cast<clang::DeclRefExpr>(expr)) {
+            return llvm::dyn_cast<clang::VarDecl>(decl_ref->getDecl());
+        }
+        return nullptr;
+    }
+
+    auto collectAssigned(const clang::Stmt *stmt) -> void {
+        if (stmt == nullptr) {
+            return;
+        }
+        const clang::VarDecl *var_decl = nullptr;
+        if (auto binop = llvm::dyn_cast<clang::BinaryOperator>(stmt);
+            binop && binop->isAssignmentOp()) {
+            var_decl = getVarDecl(binop->getLHS());
+        } else if (auto unop = llvm::dyn_cast<clang::UnaryOperator>(stmt);
+                   unop && (unop->isIncrementDecrementOp() ||
+                            unop->getOpcode() == clang::UO_AddrOf)) {
+            var_decl = getVarDecl(unop->getSubExpr());
+        }
+        if (var_decl) {
+            m_assigned.insert(var_decl);
+        }
+        // a function may write the variables bound to its T & parameters
+        if (auto call = llvm::dyn_cast<clang::CallExpr>(stmt)) {
+            auto callee = call->getDirectCallee();
+            unsigned first_arg =
+                llvm::isa<clang::CXXOperatorCallExpr>(call) &&
+                        llvm::isa_and_nonnull<clang::CXXMethodDecl>(callee)
+                    ? 1
+                    : 0;
+            for (unsigned i = first_arg;
+                 callee && i < call->getNumArgs() &&
+                 i - first_arg < callee->getNumParams();
+                 i++) {
+                auto bound = getVarDecl(call->getArg(i));
+                if (bound && isMutableReference(
+                                 callee->getParamDecl(i - first_arg)
+                                     ->getType())) {
+                    m_assigned.insert(bound);
+                }
+            }
+        }
+        for (auto child : stmt->children()) {
+            collectAssigned(child);
+        }
+    }
+
+    /// \return true if the expression is uniform and not written in the kernel
+    auto isStable(const clang::Expr *expr) -> bool {
+        return isUniformExpr(expr, m_stable) && !refersToAssigned(expr);
+    }
+
+    auto refersToAssigned(const clang::Stmt *stmt) -> bool {
+        if (auto decl_ref = llvm::dyn_cast<clang::DeclRefExpr>(stmt)) {
+            auto var_decl = llvm::dyn_cast<clang::VarDecl>(decl_ref->getDecl());
+            return var_decl && m_assigned.count(var_decl);
+        }
+        for (auto child : stmt->children()) {
+            if (child && refersToAssigned(child)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    auto collectLocalRefs(const clang::Stmt *stmt,
+                          std::vector<const clang::DeclRefExpr *> &refs)
+        -> void {
+        if (auto decl_ref = llvm::dyn_cast<clang::DeclRefExpr>(stmt)) {
+            auto var_decl = llvm::dyn_cast<clang::VarDecl>(decl_ref->getDecl());
+            if (var_decl && var_decl->isLocalVarDecl()) {
+                refs.push_back(decl_ref);
+            }
+            return;
+        }
+        for (auto child : stmt->children()) {
+            if (child) {
+                collectLocalRefs(child, refs);
+            }
+        }
+    }
+
+    /// \return the source of a stable expression with its local variables
+    /// replaced by their stable initializers, nullopt if one has none
+    auto getRootedSource(const clang::Expr *expr)
+        -> std::optional<std::string> {
+        std::vector<const clang::DeclRefExpr *> refs;
+        collectLocalRefs(expr, refs);
+        if (refs.empty()) {
+            return SRCDUMP(expr);
+        }
+        clang::Rewriter rewriter(m_sm, m_lang_opts);
+        for (auto decl_ref : refs) {
+            auto var_decl = llvm::cast<clang::VarDecl>(decl_ref->getDecl());
+            auto root = m_rooted.find(var_decl);
+            if (root == m_rooted.end()) {
+                std::optional<std::string> source;
+                if (m_stable.count(var_decl) && var_decl->getInit() &&
+                    isStable(var_decl->getInit())) {
+                    source = getRootedSource(var_decl->getInit());
+                }
+                root = m_rooted.emplace(var_decl, source).first;
+            }
+            if (!root->second ||
+                rewriter.ReplaceText(decl_ref->getSourceRange(),
+                                     "(" + *root->second + ")")) {
+                return std::nullopt;
+            }
+        }
+        return rewriter.getRewrittenText(expr->getSourceRange());
+    }
+
+    auto getAffineBase(const clang::Expr *expr) -> std::optional<std::string> {
+        expr = expr->IgnoreParenImpCasts();
+        if (isThreadIdxX(expr)) {
+            return std::string("0");
+        }
+        if (auto var_decl = getVarDecl(expr)) {
+            if (auto affine = m_affine_vars.find(var_decl);
+                affine != m_affine_vars.end()) {
+                return affine->second;
+            }
+            return std::nullopt;
+        }
+        auto binop = llvm::dyn_cast<clang::BinaryOperator>(expr);
+        if (!binop) {
+            return std::nullopt;
+        }
+        auto join = [](const std::string &lhs, const std::string &op,
+                       const std::string &rhs) {
+            if (lhs == "0" && op == "+") {
+                return "(" + rhs + ")";
+            }
+            return "(" + lhs + ") " + op + " (" + rhs + ")";
+        };
+        auto getStableSource = [this](const clang::Expr *expr) {
+            return isStable(expr) ? getRootedSource(expr) : std::nullopt;
+        };
+        if (binop->getOpcode() == clang::BO_Add) {
+            if (auto lhs = getAffineBase(binop->getLHS())) {
+                if (auto rhs = getStableSource(binop->getRHS())) {
+                    return join(*lhs, "+", *rhs);
+                }
+            }
+            if (auto rhs = getAffineBase(binop->getRHS())) {
+                if (auto lhs = getStableSource(binop->getLHS())) {
+                    return join(*rhs, "+", *lhs);
+                }
+            }
+        } else if (binop->getOpcode() == clang::BO_Sub) {
+            if (auto lhs = getAffineBase(binop->getLHS())) {
+                if (auto rhs = getStableSource(binop->getRHS())) {
+                    return join(*lhs, "-", *rhs);
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+    /// only kernel pointers and shared memory are laid out contiguously
+    auto isContiguousArray(const clang::Expr *base) -> bool {
+        auto var_decl = getVarDecl(base);
+        if (!var_decl) {
+            return false;
+        }
+        if (var_decl->hasAttr<clang::CUDASharedAttr>()) {
+            return true;
+        }
+        auto func_decl =
+            llvm::dyn_cast<clang::FunctionDecl>(var_decl->getDeclContext());
+        return llvm::isa<clang::ParmVarDecl>(var_decl) && func_decl &&
+               func_decl->hasAttr<clang::CUDAGlobalAttr>() &&
+               var_decl->getType()->isPointerType();
+    }
+
+    auto collectSubscripts(const clang::Stmt *stmt) -> void {
+        if (stmt == nullptr) {
+            return;
+        }
+        if (auto subscript = llvm::dyn_cast<clang::ArraySubscriptExpr>(stmt);
+            subscript && isContiguousArray(subscript->getBase())) {
+            if (auto base = getAffineBase(subscript->getIdx()); base) {
+                SPMDFY_INFO("[DetectCoalescedAccess] Coalesced access {}",
+                            SRCDUMP(subscript));
+                m_workspace.coalesced_access[subscript] = *base;
+            }
+        }
+        for (auto child : stmt->children()) {
+            collectSubscripts(child);
+        }
+    }
+
+    // AST specific variables
+    clang::ASTContext &m_ast_context;
+    clang::SourceManager &m_sm;
+    clang::LangOptions m_lang_opts;
+
+    Workspace &m_workspace;
+    bool m_collect = false;
+    std::set<const clang::VarDecl *> m_assigned;
+    std::set<const clang::VarDecl *> m_stable;
+    std::map<const clang::VarDecl *, std::string> m_affine_vars;
+    /// stable local variables expanded to their initializers
+    std::map<const clang::VarDecl *, std::optional<std::string>> m_rooted;
+};
+
+bool detectCoalescedAccess(SpmdTUTy &spmd_tu, clang::ASTContext &ast_context,
+                           Workspace &workspace) {
+    for (auto node : spmd_tu) {
+        if (ISNODE(node, cfg::CFGNode::KernelFunc)) {
+            SPMDFY_INFO("[DetectCoalescedAccess] Visiting Kernel Func {}",
+                        node->getName());
+            DetectCoalesced detector(ast_context, workspace);
+            detector.run(llvm::cast<cfg::KernelFuncNode>(node));
+        }
+    }
+    return false;
+}
+
+} // namespace pass
+
+} // namespace spmdfy
@@ -4,8 +4,6 @@ namespace spmdfy {
 
 namespace pass {
 
-#define CASTAS(TYPE, NODE) dynamic_cast<TYPE>(NODE)
-
 bool handleKernelFunc(cfg::KernelFuncNode *kernel, clang::ASTContext &context,
                       Workspace &workspace) {
     int curr_block = -1;
@@ -16,11 +14,13 @@ bool handleKernelFunc(cfg::KernelFuncNode *kernel, clang::ASTContext &context,
         if (ISNODE(curr_node, cfg::CFGNode::ISPCBlock)) {
             curr_block++;
         } else if (ISNODE(curr_node, cfg::CFGNode::Internal)) {
-            auto internal = CASTAS(cfg::InternalNode *, curr_node);
+            auto internal = llvm::cast<cfg::InternalNode>(curr_node);
             if (internal->getName() == "Var") {
                 auto var_decl =
                     internal->getInternalNodeAs<const clang::VarDecl>();
-                if (!var_decl->hasAttr<clang::CUDASharedAttr>()) {
+                // scalars stay in place and are spilled across barriers
+                if (!var_decl->hasAttr<clang::CUDASharedAttr>() &&
+                    !isSpillableVar(var_decl)) {
                     SPMDFY_INFO("[DetectPartialNodes] Detected Function Scope "
                                 "variable {} of block scope {}",
                                 internal->getName(), curr_block);
@@ -28,8 +28,8 @@ bool handleKernelFunc(cfg::KernelFuncNode *kernel, clang::ASTContext &context,
                     cfg::rmCFGNode(internal);
                 }
             }
-        } else if (auto cond_node = CASTAS(cfg::ConditionalNode *, curr_node);
-                   cond_node) {
+        } else if (auto cond_node =
+                       llvm::dyn_cast<cfg::ConditionalNode>(curr_node)) {
             curr_node = cond_node->getReconv();
         }
     }
@@ -41,7 +41,7 @@ bool detectPartialNodes(SpmdTUTy &spmd_tu, clang::ASTContext &ast_context,
     for (auto decl : spmd_tu) {
         SPMDFY_INFO("[DetectPartialNodes] Visiting Kernel Func");
         if (ISNODE(decl, cfg::CFGNode::KernelFunc)) {
-            handleKernelFunc(CASTAS(cfg::KernelFuncNode *, decl), ast_context,
+            handleKernelFunc(llvm::cast<cfg::KernelFuncNode>(decl), ast_context,
                              workspace);
         }
     }
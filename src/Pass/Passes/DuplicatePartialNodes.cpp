@@ -4,12 +4,11 @@ namespace spmdfy {
 
 namespace pass {
 
-#define CASTAS(TYPE, NODE) dynamic_cast<TYPE>(NODE)
-
 auto duplicateInternalNode(clang::ASTContext &ast_context,
-                           cfg::InternalNode *node) -> cfg::InternalNode * {
+                           cfg::CFGArena &arena, cfg::InternalNode *node)
+    -> cfg::InternalNode * {
     auto duplicate =
-        new cfg::InternalNode(ast_context, node->getInternalNode());
+        arena.create<cfg::InternalNode>(ast_context, node->getInternalNode());
     return duplicate;
 }
 
@@ -30,8 +29,9 @@ bool duplicatePartialNodes(SpmdTUTy &spmd_tu, clang::ASTContext &ast_context,
                         for (auto var : partial_nodes[i]) {
                             SPMDFY_INFO("[DuplicatePartial Nodes] Inserting {}",
                                         var->getName());
-                            curr_node = curr_node->splitEdge(
-                                duplicateInternalNode(ast_context, var));
+                            curr_node =
+                                curr_node->splitEdge(duplicateInternalNode(
+                                    ast_context, *workspace.arena, var));
                         }
                     }
                 }
@@ -0,0 +1,424 @@
+#include <spmdfy/CUDA2ISPC.hpp>
+#include <spmdfy/Pass/Passes/DetectCoalescedAccess.hpp>
+#include <spmdfy/Pass/Passes/EliminateBarriers.hpp>
+
+#include <algorithm>
+#include <optional>
+
+namespace spmdfy {
+
+namespace pass {
+
+/// Memory reached through kernel pointers and __device__ variables. Unknown
+/// memory(e.g. local pointers) is keyed by nullptr and aliases everything
+static const char global_memory_tag = 0;
+static const void *const global_memory = &global_memory_tag;
+
+/// How a region of the kernel touches a memory object. An access is lane
+/// private when every thread only touches the element at its own index
+struct Access {
+    bool read = false;
+    bool write = false;
+    bool lane_private = true;
+};
+
+using AccessSetTy = std::map<const void *, Access>;
+
+static auto merge(AccessSetTy &into, const AccessSetTy &from) -> void {
+    for (auto &[object, access] : from) {
+        auto &into_access = into[object];
+        into_access.read |= access.read;
+        into_access.write |= access.write;
+        into_access.lane_private &= access.lane_private;
+    }
+}
+
+static auto conflicts(const Access &a, const Access &b) -> bool {
+    if (a.lane_private && b.lane_private) {
+        return false;
+    }
+    return (a.write && (b.read || b.write)) || (a.read && b.write);
+}
+
+/// \return true if there is a RAW, WAR or WAW hazard between the regions
+static auto hasHazard(const AccessSetTy &before, const AccessSetTy &after)
+    -> bool {
+    for (auto &[object, access] : before) {
+        for (auto &[other_object, other_access] : after) {
+            bool may_alias = object == other_object || object == nullptr ||
+                             other_object == nullptr;
+            if (may_alias && conflicts(access, other_access)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/// sum of products of CUDA builtins, e.g. {threadIdx.x} + {blockDim.x,
+/// threadIdx.y}, the factors of a product are sorted
+using PolynomialTy = std::map<std::vector<std::string>, int64_t>;
+
+/// \return the CUDA builtin member e.g. "threadIdx.y", empty if the
+/// expression is not one
+static auto getBuiltinName(const clang::Expr *expr) -> std::string {
+    expr = expr->IgnoreParenImpCasts();
+    if (auto pseudo = llvm::dyn_cast<clang::PseudoObjectExpr>(expr)) {
+        expr = pseudo->getSyntacticForm();
+    }
+    auto property = llvm::dyn_cast<clang::MSPropertyRefExpr>(expr);
+    if (!property) {
+        return std::string();
+    }
+    auto base = llvm::dyn_cast<clang::DeclRefExpr>(
+        property->getBaseExpr()->IgnoreParenImpCasts());
+    if (!base || base->getDecl()->getParentFunctionOrMethod()) {
+        return std::string();
+    }
+    return base->getDecl()->getName().str() + "." +
+           property->getPropertyDecl()->getName().str();
+}
+
+/// \return the index expanded into a sum of products of CUDA builtins, or
+/// nullopt if it has other terms
+static auto expandIndex(const clang::Expr *expr)
+    -> std::optional<PolynomialTy> {
+    expr = expr->IgnoreParenImpCasts();
+    if (auto builtin = getBuiltinName(expr); !builtin.empty()) {
+        return PolynomialTy{{{builtin}, 1}};
+    }
+    auto binop = llvm::dyn_cast<clang::BinaryOperator>(expr);
+    if (!binop || (binop->getOpcode() != clang::BO_Add &&
+                   binop->getOpcode() != clang::BO_Mul)) {
+        return std::nullopt;
+    }
+    auto lhs = expandIndex(binop->getLHS());
+    auto rhs = expandIndex(binop->getRHS());
+    if (!lhs || !rhs) {
+        return std::nullopt;
+    }
+    if (binop->getOpcode() == clang::BO_Add) {
+        for (auto &[term, coefficient] : *rhs) {
+            (*lhs)[term] += coefficient;
+        }
+        return lhs;
+    }
+    PolynomialTy product;
+    for (auto &[lhs_term, lhs_coefficient] : *lhs) {
+        for (auto &[rhs_term, rhs_coefficient] : *rhs) {
+            std::vector<std::string> term = lhs_term;
+            term.insert(term.end(), rhs_term.begin(), rhs_term.end());
+            std::sort(term.begin(), term.end());
+            product[term] += lhs_coefficient * rhs_coefficient;
+        }
+    }
+    return product;
+}
+
+/// \return true if the index is the linear index of the thread in its block,
+/// threadIdx.x + blockDim.x * (threadIdx.y + blockDim.y * threadIdx.z) in any
+/// order, so that no two threads of a block share it
+static auto isLinearThreadIdx(const clang::Expr *expr) -> bool {
+    static const PolynomialTy linear = {
+        {{"threadIdx.x"}, 1},
+        {{"blockDim.x", "threadIdx.y"}, 1},
+        {{"blockDim.x", "blockDim.y", "threadIdx.z"}, 1}};
+    auto index = expandIndex(expr);
+    return index && *index == linear;
+}
+
+/// \return true if the function is a CUDA math or warp function, or one of
+/// the min, max, abs and make_* helpers, which only read their arguments
+static auto isPureBuiltin(const std::string &name) -> bool {
+    return g_SpmdfyMathInstrinsicsMap.count(name) ||
+           g_SpmdfyWarpMap.count(name) || name == "min" || name == "max" ||
+           name == "abs" || llvm::StringRef(name).startswith("make_");
+}
+
+/**
+ * Splits the kernel into regions at every __syncthreads and removes the
+ * barriers whose regions on either side have no cross-lane hazard on shared
+ * or global memory. A barrier inside a loop also sees the whole loop body on
+ * both sides as the body wraps around.
+ * */
+class BarrierEliminator {
+  public:
+    BarrierEliminator(clang::ASTContext &ast_context, Workspace &workspace)
+        : m_ast_context(ast_context), m_sm(ast_context.getSourceManager()),
+          m_workspace(workspace) {}
+
+    auto run(cfg::KernelFuncNode *kernel) -> void {
+        auto &syncthreads_queue =
+            m_workspace.syncthreads_queue[kernel->getName()];
+        while (syncthreads_queue.size()) {
+            m_barriers.insert(syncthreads_queue.front());
+            syncthreads_queue.pop();
+        }
+        walk(kernel->getNext(), nullptr);
+
+        AccessSetTy before;
+        for (size_t i = 0; i < m_regions.size(); i++) {
+            auto &region = m_regions[i];
+            if (region.barrier == nullptr) {
+                merge(before, region.access);
+                continue;
+            }
+            AccessSetTy lhs = before, rhs;
+            for (size_t j = i + 1;
+                 j < m_regions.size() && m_regions[j].barrier == nullptr; j++) {
+                merge(rhs, m_regions[j].access);
+            }
+            if (region.loop) {
+                merge(lhs, m_loop_access[region.loop]);
+                merge(rhs, m_loop_access[region.loop]);
+            }
+            if (hasHazard(lhs, rhs)) {
+                syncthreads_queue.push(region.barrier);
+                before.clear();
+            } else {
+                SPMDFY_INFO("[EliminateBarriers] Removing __syncthreads after "
+                            "{}",
+                            region.barrier->getPrevious()->getName());
+                cfg::rmCFGNode(region.barrier);
+            }
+        }
+    }
+
+  private:
+    enum class Ctx { Read, Write, ReadWrite };
+
+    /// A statement's accesses or a barrier, in program order
+    struct Region {
+        cfg::InternalNode *barrier;
+        cfg::ForStmtNode *loop;
+        AccessSetTy access;
+    };
+
+    auto addRegion(const clang::Stmt *stmt, cfg::ForStmtNode *loop) -> void {
+        AccessSetTy access;
+        visit(stmt, Ctx::Read, access, false);
+        if (loop) {
+            merge(m_loop_access[loop], access);
+        }
+        m_regions.push_back({nullptr, loop, access});
+    }
+
+    auto walk(cfg::CFGNode *node, cfg::ForStmtNode *loop) -> void {
+        for (auto curr_node = node; !ISNODE(curr_node, cfg::CFGNode::Reconv) &&
+                                    !ISNODE(curr_node, cfg::CFGNode::Exit);
+             curr_node = curr_node->getNext()) {
+            switch (curr_node->getNodeType()) {
+            case cfg::CFGNode::Internal: {
+                auto internal = llvm::cast<cfg::InternalNode>(curr_node);
+                if (m_barriers.count(internal)) {
+                    m_regions.push_back({internal, loop, {}});
+                    break;
+                }
+                std::visit(
+                    Overload{[&](const clang::Decl *decl) {
+                                 if (auto var_decl =
+                                         llvm::dyn_cast<clang::VarDecl>(decl)) {
+                                     addRegion(var_decl->getInit(), loop);
+                                 }
+                             },
+                             [&](const clang::Stmt *stmt) {
+                                 addRegion(stmt, loop);
+                             },
+                             [&](const clang::Expr *expr) {
+                                 addRegion(expr, loop);
+                             },
+                             [](const clang::Type *) {}},
+                    internal->getInternalNode());
+                break;
+            }
+            case cfg::CFGNode::IfStmt: {
+                auto if_node = llvm::cast<cfg::IfStmtNode>(curr_node);
+                addRegion(if_node->getIfStmt()->getCond(), loop);
+                walk(if_node->getTrueBlock(), loop);
+                walk(if_node->getFalseBlock(), loop);
+                curr_node = if_node->getReconv();
+                break;
+            }
+            case cfg::CFGNode::ForStmt: {
+                auto for_node = llvm::cast<cfg::ForStmtNode>(curr_node);
+                auto for_stmt = for_node->getForStmt();
+                auto outer_loop = loop ? loop : for_node;
+                addRegion(for_stmt->getInit(), outer_loop);
+                addRegion(for_stmt->getCond(), outer_loop);
+                addRegion(for_stmt->getInc(), outer_loop);
+                walk(for_node->getNext(), outer_loop);
+                curr_node = for_node->getReconv();
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+
+    auto record(AccessSetTy &access, const void *object, Ctx ctx,
+                bool lane_private) -> void {
+        auto &object_access = access[object];
+        object_access.read |= ctx != Ctx::Write;
+        object_access.write |= ctx != Ctx::Read;
+        object_access.lane_private &= lane_private && object != nullptr;
+    }
+
+    /// \return the memory object, nullptr for unknown memory or nullopt for
+    /// thread private storage
+    auto getObject(const clang::Expr *expr) -> std::optional<const void *> {
+        auto decl_ref =
+            llvm::dyn_cast<clang::DeclRefExpr>(expr->IgnoreParenImpCasts());
+        if (!decl_ref) {
+            return nullptr;
+        }
+        auto var_decl = llvm::dyn_cast<clang::VarDecl>(decl_ref->getDecl());
+        if (!var_decl) {
+            return std::nullopt;
+        }
+        if (var_decl->hasAttr<clang::CUDASharedAttr>()) {
+            return var_decl;
+        }
+        if (var_decl->isFileVarDecl() &&
+            var_decl->hasAttr<clang::CUDADeviceAttr>()) {
+            return global_memory;
+        }
+        if (var_decl->getType()->isPointerType()) {
+            auto func_decl =
+                llvm::dyn_cast<clang::FunctionDecl>(var_decl->getDeclContext());
+            bool is_kernel_param =
+                llvm::isa<clang::ParmVarDecl>(var_decl) && func_decl &&
+                func_decl->hasAttr<clang::CUDAGlobalAttr>();
+            return is_kernel_param ? global_memory : nullptr;
+        }
+        return std::nullopt;
+    }
+
+    auto visit(const clang::Stmt *stmt, Ctx ctx, AccessSetTy &access,
+               bool escape) -> void {
+        if (stmt == nullptr) {
+            return;
+        }
+        if (auto expr = llvm::dyn_cast<clang::Expr>(stmt)) {
+            stmt = expr->IgnoreParenImpCasts();
+        }
+        if (llvm::isa<clang::PseudoObjectExpr>(stmt)) {
+            // CUDA builtin variables e.g. threadIdx.x
+            return;
+        }
+        if (auto binop = llvm::dyn_cast<clang::BinaryOperator>(stmt)) {
+            if (binop->isAssignmentOp()) {
+                visit(binop->getLHS(),
+                      binop->isCompoundAssignmentOp() ? Ctx::ReadWrite
+                                                      : Ctx::Write,
+                      access, escape);
+            } else {
+                visit(binop->getLHS(), Ctx::Read, access, escape);
+            }
+            visit(binop->getRHS(), Ctx::Read, access, escape);
+            return;
+        }
+        if (auto unop = llvm::dyn_cast<clang::UnaryOperator>(stmt)) {
+            if (unop->isIncrementDecrementOp()) {
+                visit(unop->getSubExpr(), Ctx::ReadWrite, access, escape);
+            } else if (unop->getOpcode() == clang::UO_Deref) {
+                auto object = getObject(unop->getSubExpr());
+                record(access, object ? *object : nullptr, ctx, false);
+                visit(unop->getSubExpr(), Ctx::Read, access, escape);
+            } else if (unop->getOpcode() == clang::UO_AddrOf) {
+                visit(unop->getSubExpr(), Ctx::ReadWrite, access, true);
+            } else {
+                visit(unop->getSubExpr(), Ctx::Read, access, escape);
+            }
+            return;
+        }
+        if (auto subscript = llvm::dyn_cast<clang::ArraySubscriptExpr>(stmt)) {
+            if (auto object = getObject(subscript->getBase()); object) {
+                // threads with the same threadIdx.x but different y or z
+                // share an element indexed by threadIdx.x alone, the generic
+                // kernel body runs with blocks of any shape
+                record(access, *object, ctx,
+                       !escape && isLinearThreadIdx(subscript->getIdx()));
+            }
+            if (!llvm::isa<clang::DeclRefExpr>(
+                    subscript->getBase()->IgnoreParenImpCasts())) {
+                visit(subscript->getBase(), Ctx::Read, access, escape);
+            }
+            visit(subscript->getIdx(), Ctx::Read, access, false);
+            return;
+        }
+        if (auto member = llvm::dyn_cast<clang::MemberExpr>(stmt)) {
+            if (member->isArrow()) {
+                auto object = getObject(member->getBase());
+                record(access, object ? *object : nullptr, ctx, false);
+                visit(member->getBase(), Ctx::Read, access, escape);
+            } else {
+                visit(member->getBase(), ctx, access, escape);
+            }
+            return;
+        }
+        if (auto decl_ref = llvm::dyn_cast<clang::DeclRefExpr>(stmt)) {
+            auto var_decl = llvm::dyn_cast<clang::VarDecl>(decl_ref->getDecl());
+            if (var_decl && !var_decl->getType()->isPointerType()) {
+                if (auto object = getObject(decl_ref); object) {
+                    // arrays decaying to pointers escape
+                    record(access, *object,
+                           var_decl->getType()->isArrayType() ? Ctx::ReadWrite
+                                                              : ctx,
+                           false);
+                }
+            }
+            return;
+        }
+        if (auto call = llvm::dyn_cast<clang::CallExpr>(stmt)) {
+            auto callee = call->getDirectCallee();
+            std::string callee_name =
+                callee ? callee->getNameAsString() : std::string();
+            bool is_atomic =
+                g_SpmdfyAtomicMap.find(callee_name) != g_SpmdfyAtomicMap.end();
+            // a __device__ function, wherever it is defined, may touch
+            // __device__ and __shared__ variables
+            bool may_access_memory =
+                callee == nullptr || !isPureBuiltin(callee_name);
+            for (unsigned i = 0; i < call->getNumArgs(); i++) {
+                auto arg = call->getArg(i);
+                visit(arg, is_atomic && i == 0 ? Ctx::ReadWrite : Ctx::Read,
+                      access, escape);
+                may_access_memory |= arg->getType()->isPointerType();
+            }
+            if (!is_atomic && callee_name != "printf" && may_access_memory) {
+                record(access, nullptr, Ctx::ReadWrite, false);
+            }
+            return;
+        }
+        for (auto child : stmt->children()) {
+            visit(child, Ctx::Read, access, escape);
+        }
+    }
+
+    // AST specific variables
+    clang::ASTContext &m_ast_context;
+    clang::SourceManager &m_sm;
+
+    Workspace &m_workspace;
+    std::set<cfg::InternalNode *> m_barriers;
+    std::vector<Region> m_regions;
+    std::map<cfg::ForStmtNode *, AccessSetTy> m_loop_access;
+};
+
+bool eliminateBarriers(SpmdTUTy &spmd_tu, clang::ASTContext &ast_context,
+                       Workspace &workspace) {
+    for (auto node : spmd_tu) {
+        if (ISNODE(node, cfg::CFGNode::KernelFunc)) {
+            SPMDFY_INFO("[EliminateBarriers] Visiting Kernel Func {}",
+                        node->getName());
+            BarrierEliminator eliminator(ast_context, workspace);
+            eliminator.run(llvm::cast<cfg::KernelFuncNode>(node));
+        }
+    }
+    return false;
+}
+
+} // namespace pass
+
+} // namespace spmdfy
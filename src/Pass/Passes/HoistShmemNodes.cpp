@@ -4,8 +4,6 @@ namespace spmdfy {
 
 namespace pass {
 
-#define CASTAS(TYPE, NODE) dynamic_cast<TYPE>(NODE)
-
 auto getISPCGridNode(cfg::KernelFuncNode *kernel){
     return kernel->getNext();
 }
@@ -16,7 +14,7 @@ bool hoistShmemNodes(SpmdTUTy &spmd_tu, clang::ASTContext &ast_context,
         SPMDFY_INFO("[HoistShmemNodes] Visiting Node {}", node->getNodeTypeName());
         if (node->getNodeType() == cfg::CFGNode::KernelFunc) {
             auto kernel_name = node->getName();
-            auto grid_node = node->getNext(); //getISPCGridNode(CASTAS(cfg::KernelFuncNode*, node));
+            auto grid_node = node->getNext(); //getISPCGridNode(llvm::cast<cfg::KernelFuncNode>(node));
             auto& queue = workspace.shmem_queue[kernel_name];
             while(queue.size()){
                 auto shmem_node = queue.front();
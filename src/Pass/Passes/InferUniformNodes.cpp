@@ -0,0 +1,411 @@
+#include <spmdfy/Pass/Passes/InferUniformNodes.hpp>
+
+namespace spmdfy {
+
+namespace pass {
+
+using UniformSetTy = std::set<const clang::VarDecl *>;
+
+/// CUDA builtin variables which hold the same value for a whole block
+static bool isUniformBuiltin(const clang::VarDecl *var_decl) {
+    if (var_decl->isLocalVarDeclOrParm()) {
+        return false;
+    }
+    const std::string name = var_decl->getNameAsString();
+    return name == "blockIdx" || name == "blockDim" || name == "gridDim" ||
+           name == "warpSize";
+}
+
+/// \return true if the expression is the CUDA builtin threadIdx
+static bool isThreadIdx(const clang::Expr *expr) {
+    auto base = llvm::dyn_cast<clang::DeclRefExpr>(expr->IgnoreParenImpCasts());
+    return base && base->getDecl()->getName() == "threadIdx" &&
+           !base->getDecl()->getParentFunctionOrMethod();
+}
+
+/// kernel parameters are emitted as uniform by the codegen
+static bool isKernelParam(const clang::VarDecl *var_decl) {
+    if (!llvm::isa<clang::ParmVarDecl>(var_decl)) {
+        return false;
+    }
+    auto func_decl =
+        llvm::dyn_cast<clang::FunctionDecl>(var_decl->getDeclContext());
+    return func_decl && func_decl->hasAttr<clang::CUDAGlobalAttr>();
+}
+
+bool isUniformExpr(const clang::Stmt *stmt, const UniformSetTy &uniform) {
+    if (stmt == nullptr) {
+        return true;
+    }
+    if (auto expr = llvm::dyn_cast<clang::Expr>(stmt)) {
+        stmt = expr->IgnoreParenImpCasts();
+    }
+    auto all_uniform = [&uniform](const clang::Stmt *stmt) {
+        for (auto child : stmt->children()) {
+            if (!isUniformExpr(child, uniform)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (llvm::isa<clang::IntegerLiteral>(stmt) ||
+        llvm::isa<clang::FloatingLiteral>(stmt) ||
+        llvm::isa<clang::CharacterLiteral>(stmt) ||
+        llvm::isa<clang::CXXBoolLiteralExpr>(stmt) ||
+        llvm::isa<clang::UnaryExprOrTypeTraitExpr>(stmt)) {
+        return true;
+    }
+    if (auto decl_ref = llvm::dyn_cast<clang::DeclRefExpr>(stmt)) {
+        auto decl = decl_ref->getDecl();
+        if (llvm::isa<clang::EnumConstantDecl>(decl)) {
+            return true;
+        }
+        auto var_decl = llvm::dyn_cast<clang::VarDecl>(decl);
+        if (!var_decl) {
+            return false;
+        }
+        return isUniformBuiltin(var_decl) || isKernelParam(var_decl) ||
+               uniform.count(var_decl) ||
+               (var_decl->isFileVarDecl() &&
+                var_decl->getType().isConstQualified());
+    }
+    // the template arguments of a kernel specialization are constants
+    if (llvm::isa<clang::SubstNonTypeTemplateParmExpr>(stmt)) {
+        return true;
+    }
+    // blockIdx.x and friends are properties of the builtin variables
+    if (auto pseudo = llvm::dyn_cast<clang::PseudoObjectExpr>(stmt)) {
+        return isUniformExpr(pseudo->getSyntacticForm(), uniform);
+    }
+    if (auto property = llvm::dyn_cast<clang::MSPropertyRefExpr>(stmt)) {
+        // threadIdx.y and threadIdx.z are the uniform counters of the block
+        // loops, only threadIdx.x varies across the gang
+        if (isThreadIdx(property->getBaseExpr())) {
+            return property->getPropertyDecl()->getName() != "x";
+        }
+        return isUniformExpr(property->getBaseExpr(), uniform);
+    }
+    if (auto member = llvm::dyn_cast<clang::MemberExpr>(stmt)) {
+        return !member->isArrow() && isUniformExpr(member->getBase(), uniform);
+    }
+    if (auto binop = llvm::dyn_cast<clang::BinaryOperator>(stmt)) {
+        return !binop->isAssignmentOp() && all_uniform(binop);
+    }
+    if (auto unop = llvm::dyn_cast<clang::UnaryOperator>(stmt)) {
+        switch (unop->getOpcode()) {
+        case clang::UO_Plus:
+        case clang::UO_Minus:
+        case clang::UO_Not:
+        case clang::UO_LNot:
+            return all_uniform(unop);
+        default:
+            return false;
+        }
+    }
+    if (llvm::isa<clang::ConditionalOperator>(stmt) ||
+        llvm::isa<clang::CastExpr>(stmt) || llvm::isa<clang::ParenExpr>(stmt)) {
+        return all_uniform(stmt);
+    }
+    return false;
+}
+
+bool isMutableReference(clang::QualType type) {
+    return type->isLValueReferenceType() &&
+           !type.getNonReferenceType().isConstQualified();
+}
+
+bool isUniformAddress(const clang::Expr *addr, const UniformSetTy &uniform) {
+    addr = addr->IgnoreParenImpCasts();
+    auto addr_of = llvm::dyn_cast<clang::UnaryOperator>(addr);
+    if (!addr_of || addr_of->getOpcode() != clang::UO_AddrOf) {
+        return isUniformExpr(addr, uniform);
+    }
+    auto lvalue = addr_of->getSubExpr()->IgnoreParenImpCasts();
+    if (auto subscript = llvm::dyn_cast<clang::ArraySubscriptExpr>(lvalue)) {
+        return isUniformExpr(subscript->getBase(), uniform) &&
+               isUniformExpr(subscript->getIdx(), uniform);
+    }
+    if (auto decl_ref = llvm::dyn_cast<clang::DeclRefExpr>(lvalue)) {
+        auto var_decl = llvm::dyn_cast<clang::VarDecl>(decl_ref->getDecl());
+        return var_decl && var_decl->hasGlobalStorage();
+    }
+    return false;
+}
+
+/**
+ * Optimistically assumes every scalar local is uniform and demotes the ones
+ * that are written with a varying value or under varying control flow until
+ * a fixed point is reached.
+ * */
+class InferUniform {
+  public:
+    InferUniform(UniformSetTy &uniform) : m_uniform(uniform) {}
+
+    auto run(cfg::KernelFuncNode *kernel) -> void {
+        m_collect = true;
+        walk(kernel->getNext(), false);
+        m_collect = false;
+        do {
+            m_changed = false;
+            walk(kernel->getNext(), false);
+        } while (m_changed);
+    }
+
+  private:
+    auto demote(const clang::VarDecl *var_decl) -> void {
+        if (m_uniform.erase(var_decl)) {
+            SPMDFY_INFO("[InferUniformNodes] {} is varying",
+                        var_decl->getNameAsString());
+            m_changed = true;
+        }
+    }
+
+    auto handleVarDecl(const clang::VarDecl *var_decl, bool varying_cf)
+        -> void {
+        if (m_collect) {
+            clang::QualType type = var_decl->getType();
+            if (var_decl->isLocalVarDecl() && !var_decl->isStaticLocal() &&
+                !var_decl->hasAttr<clang::CUDASharedAttr>() &&
+                (type->isIntegerType() || type->isRealFloatingType() ||
+                 type->isBooleanType())) {
+                m_uniform.insert(var_decl);
+            }
+            return;
+        }
+        if (varying_cf || !isUniformExpr(var_decl->getInit(), m_uniform)) {
+            demote(var_decl);
+        }
+        if (auto init = var_decl->getInit()) {
+            if (auto bound = getVarDecl(init);
+                bound && isMutableReference(var_decl->getType())) {
+                demote(bound);
+            }
+            handleStmt(init, varying_cf);
+        }
+    }
+
+    auto getVarDecl(const clang::Expr *expr) -> const clang::VarDecl * {
+        expr = expr->IgnoreParenImpCasts();
+        if (auto decl_ref = llvm::dyn_cast<clang::DeclRefExpr>(expr)) {
+            return llvm::dyn_cast<clang::VarDecl>(decl_ref->getDecl());
+        }
+        return nullptr;
+    }
+
+    /// \return true if a break, continue or return in the body of a loop or
+    /// switch is only taken by some program instances, the statements after
+    /// it and the later iterations run under varying control flow
+    auto hasVaryingExit(const clang::Stmt *stmt, bool varying_cf) -> bool {
+        if (stmt == nullptr) {
+            return false;
+        }
+        if (llvm::isa<clang::BreakStmt>(stmt) ||
+            llvm::isa<clang::ContinueStmt>(stmt) ||
+            llvm::isa<clang::ReturnStmt>(stmt) ||
+            llvm::isa<clang::GotoStmt>(stmt)) {
+            return varying_cf;
+        }
+        if (auto cond = getCond(stmt)) {
+            varying_cf = varying_cf || !isUniformExpr(cond, m_uniform);
+        }
+        for (auto child : stmt->children()) {
+            if (hasVaryingExit(child, varying_cf)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// \return the condition of an if, switch or loop statement
+    auto getCond(const clang::Stmt *stmt) -> const clang::Expr * {
+        if (auto if_stmt = llvm::dyn_cast<clang::IfStmt>(stmt)) {
+            return if_stmt->getCond();
+        }
+        if (auto switch_stmt = llvm::dyn_cast<clang::SwitchStmt>(stmt)) {
+            return switch_stmt->getCond();
+        }
+        if (auto while_stmt = llvm::dyn_cast<clang::WhileStmt>(stmt)) {
+            return while_stmt->getCond();
+        }
+        if (auto do_stmt = llvm::dyn_cast<clang::DoStmt>(stmt)) {
+            return do_stmt->getCond();
+        }
+        if (auto for_stmt = llvm::dyn_cast<clang::ForStmt>(stmt)) {
+            return for_stmt->getCond();
+        }
+        return nullptr;
+    }
+
+    /// the control flow statements the CFG keeps inside an Internal node, a
+    /// varying condition makes their body varying control flow like the
+    /// branches of a varying if
+    auto handleControlFlow(const clang::Stmt *stmt, bool varying_cf) -> bool {
+        auto cond = getCond(stmt);
+        if (!cond && !llvm::isa<clang::ForStmt>(stmt)) {
+            return false;
+        }
+        bool cond_cf = varying_cf || !isUniformExpr(cond, m_uniform);
+        if (auto if_stmt = llvm::dyn_cast<clang::IfStmt>(stmt)) {
+            handleStmt(if_stmt->getInit(), varying_cf);
+            handleStmt(if_stmt->getConditionVariableDeclStmt(), varying_cf);
+            handleStmt(cond, varying_cf);
+            handleStmt(if_stmt->getThen(), cond_cf);
+            handleStmt(if_stmt->getElse(), cond_cf);
+        } else if (auto switch_stmt = llvm::dyn_cast<clang::SwitchStmt>(stmt)) {
+            cond_cf = cond_cf || hasVaryingExit(switch_stmt->getBody(), false);
+            handleStmt(switch_stmt->getInit(), varying_cf);
+            handleStmt(switch_stmt->getConditionVariableDeclStmt(),
+                       varying_cf);
+            handleStmt(cond, varying_cf);
+            handleStmt(switch_stmt->getBody(), cond_cf);
+        } else if (auto while_stmt = llvm::dyn_cast<clang::WhileStmt>(stmt)) {
+            // the condition is evaluated again by the remaining iterations
+            cond_cf = cond_cf || hasVaryingExit(while_stmt->getBody(), false);
+            handleStmt(while_stmt->getConditionVariableDeclStmt(), cond_cf);
+            handleStmt(cond, cond_cf);
+            handleStmt(while_stmt->getBody(), cond_cf);
+        } else if (auto do_stmt = llvm::dyn_cast<clang::DoStmt>(stmt)) {
+            cond_cf = cond_cf || hasVaryingExit(do_stmt->getBody(), false);
+            handleStmt(do_stmt->getBody(), cond_cf);
+            handleStmt(cond, cond_cf);
+        } else if (auto for_stmt = llvm::dyn_cast<clang::ForStmt>(stmt)) {
+            cond_cf = cond_cf || hasVaryingExit(for_stmt->getBody(), false);
+            handleStmt(for_stmt->getInit(), varying_cf);
+            handleStmt(for_stmt->getConditionVariableDeclStmt(), cond_cf);
+            handleStmt(cond, cond_cf);
+            handleStmt(for_stmt->getInc(), cond_cf);
+            handleStmt(for_stmt->getBody(), cond_cf);
+        }
+        return true;
+    }
+
+    auto handleStmt(const clang::Stmt *stmt, bool varying_cf) -> void {
+        if (stmt == nullptr) {
+            return;
+        }
+        if (handleControlFlow(stmt, varying_cf)) {
+            return;
+        }
+        if (auto decl_stmt = llvm::dyn_cast<clang::DeclStmt>(stmt)) {
+            for (auto decl : decl_stmt->decls()) {
+                if (auto var_decl = llvm::dyn_cast<clang::VarDecl>(decl)) {
+                    handleVarDecl(var_decl, varying_cf);
+                }
+            }
+            return;
+        }
+        if (!m_collect) {
+            if (auto binop = llvm::dyn_cast<clang::BinaryOperator>(stmt);
+                binop && binop->isAssignmentOp()) {
+                auto var_decl = getVarDecl(binop->getLHS());
+                if (var_decl && (varying_cf ||
+                                 !isUniformExpr(binop->getRHS(), m_uniform))) {
+                    demote(var_decl);
+                }
+            } else if (auto unop = llvm::dyn_cast<clang::UnaryOperator>(stmt)) {
+                auto var_decl = getVarDecl(unop->getSubExpr());
+                bool escapes = unop->getOpcode() == clang::UO_AddrOf;
+                if (var_decl && (escapes || (unop->isIncrementDecrementOp() &&
+                                             varying_cf))) {
+                    demote(var_decl);
+                }
+            } else if (auto call = llvm::dyn_cast<clang::CallExpr>(stmt)) {
+                // a __device__ function may write each lane's own value
+                // through a T & parameter
+                auto callee = call->getDirectCallee();
+                unsigned first_arg =
+                    llvm::isa<clang::CXXOperatorCallExpr>(call) &&
+                            llvm::isa_and_nonnull<clang::CXXMethodDecl>(callee)
+                        ? 1
+                        : 0;
+                for (unsigned i = first_arg; callee && i < call->getNumArgs() &&
+                                             i - first_arg <
+                                                 callee->getNumParams();
+                     i++) {
+                    auto param = callee->getParamDecl(i - first_arg);
+                    auto var_decl = getVarDecl(call->getArg(i));
+                    if (var_decl && isMutableReference(param->getType())) {
+                        demote(var_decl);
+                    }
+                }
+            }
+        }
+        for (auto child : stmt->children()) {
+            handleStmt(child, varying_cf);
+        }
+    }
+
+    auto walk(cfg::CFGNode *node, bool varying_cf) -> void {
+        for (auto curr_node = node; !ISNODE(curr_node, cfg::CFGNode::Reconv) &&
+                                    !ISNODE(curr_node, cfg::CFGNode::Exit);
+             curr_node = curr_node->getNext()) {
+            switch (curr_node->getNodeType()) {
+            case cfg::CFGNode::Internal: {
+                auto internal = llvm::cast<cfg::InternalNode>(curr_node);
+                std::visit(
+                    Overload{[&](const clang::Decl *decl) {
+                                 if (auto var_decl =
+                                         llvm::dyn_cast<clang::VarDecl>(decl)) {
+                                     handleVarDecl(var_decl, varying_cf);
+                                 }
+                             },
+                             [&](const clang::Stmt *stmt) {
+                                 handleStmt(stmt, varying_cf);
+                             },
+                             [&](const clang::Expr *expr) {
+                                 handleStmt(expr, varying_cf);
+                             },
+                             [](const clang::Type *) {}},
+                    internal->getInternalNode());
+                break;
+            }
+            case cfg::CFGNode::IfStmt: {
+                auto if_node = llvm::cast<cfg::IfStmtNode>(curr_node);
+                bool cond_cf =
+                    varying_cf ||
+                    !isUniformExpr(if_node->getIfStmt()->getCond(), m_uniform);
+                walk(if_node->getTrueBlock(), cond_cf);
+                walk(if_node->getFalseBlock(), cond_cf);
+                curr_node = if_node->getReconv();
+                break;
+            }
+            case cfg::CFGNode::ForStmt: {
+                auto for_node = llvm::cast<cfg::ForStmtNode>(curr_node);
+                auto for_stmt = for_node->getForStmt();
+                bool cond_cf = varying_cf ||
+                               !isUniformExpr(for_stmt->getCond(), m_uniform) ||
+                               hasVaryingExit(for_stmt->getBody(), false);
+                handleStmt(for_stmt->getInit(), varying_cf);
+                handleStmt(for_stmt->getInc(), cond_cf);
+                walk(for_node->getNext(), cond_cf);
+                curr_node = for_node->getReconv();
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+
+    UniformSetTy &m_uniform;
+    bool m_collect = false;
+    bool m_changed = false;
+};
+
+bool inferUniformNodes(SpmdTUTy &spmd_tu, clang::ASTContext &ast_context,
+                       Workspace &workspace) {
+    for (auto node : spmd_tu) {
+        if (ISNODE(node, cfg::CFGNode::KernelFunc)) {
+            SPMDFY_INFO("[InferUniformNodes] Visiting Kernel Func {}",
+                        node->getName());
+            InferUniform infer(workspace.uniform_vars);
+            infer.run(llvm::cast<cfg::KernelFuncNode>(node));
+        }
+    }
+    return false;
+}
+
+} // namespace pass
+
+} // namespace spmdfy
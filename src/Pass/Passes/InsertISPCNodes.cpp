@@ -5,8 +5,6 @@ namespace spmdfy {
 
 namespace pass {
 
-#define CASTAS(TYPE, NODE) dynamic_cast<TYPE>(NODE)
-
 bool insertISPCNodes(SpmdTUTy &spmd_tu, clang::ASTContext &ast_context,
                      Workspace &workspace) {
     InsertISPCNodes inserter(spmd_tu, ast_context, workspace);
@@ -21,8 +19,9 @@ auto walkBackTill(cfg::CFGNode *node,
         SPMDFY_INFO("Walking back");
         switch (curr_node->getNodeType()) {
         case cfg::CFGNode::Reconv:
-            curr_node =
-                CASTAS(cfg::ReconvNode *, curr_node)->getBack()->getPrevious();
+            curr_node = llvm::cast<cfg::ReconvNode>(curr_node)
+                            ->getBack()
+                            ->getPrevious();
             break;
         case cfg::CFGNode::IfStmt:
         case cfg::CFGNode::ForStmt:
@@ -37,19 +36,20 @@ auto walkBackTill(cfg::CFGNode *node,
 
 auto InsertISPCNodes::VisitKernelFuncNode(cfg::KernelFuncNode *kernel) -> bool {
     auto &syncthreads_queue = m_workspace.syncthreads_queue[kernel->getName()];
+    auto &arena = *m_workspace.arena;
     // 1. Inserting GridNode
-    auto grid_start = new cfg::ISPCGridNode();
+    auto grid_start = arena.create<cfg::ISPCGridNode>();
     kernel->splitEdge(grid_start);
 
     // 2. Inserting BlockNode
-    auto block_start = new cfg::ISPCBlockNode();
+    auto block_start = arena.create<cfg::ISPCBlockNode>();
     grid_start->splitEdge(block_start);
 
     // 3. Getting sync_node
     if (syncthreads_queue.empty()) {
         auto last_node = kernel->getExit()->getPrevious();
-        last_node->splitEdge(new cfg::ISPCBlockExitNode())
-            ->splitEdge(new cfg::ISPCGridExitNode());
+        last_node->splitEdge(arena.create<cfg::ISPCBlockExitNode>())
+            ->splitEdge(arena.create<cfg::ISPCGridExitNode>());
         return false;
     }
 
@@ -61,9 +61,9 @@ auto InsertISPCNodes::VisitKernelFuncNode(cfg::KernelFuncNode *kernel) -> bool {
         auto [back_node, back_node_type] = walkBackTill(sync_node);
         SPMDFY_INFO("BlockNode : {}", back_node->getName());
 
-        auto sync_block_end = new cfg::ISPCBlockExitNode();
-        auto sync_block_start = new cfg::ISPCBlockNode();
-        auto sync_replace = new cfg::ISPCBlockExitNode();
+        auto sync_block_end = arena.create<cfg::ISPCBlockExitNode>();
+        auto sync_block_start = arena.create<cfg::ISPCBlockNode>();
+        auto sync_replace = arena.create<cfg::ISPCBlockExitNode>();
         auto prev_for = back_node->getPrevious();
         auto prev_if = back_node->getPrevious();
         switch (back_node_type) {
@@ -92,18 +92,20 @@ auto InsertISPCNodes::VisitKernelFuncNode(cfg::KernelFuncNode *kernel) -> bool {
     for (; !ISNODE(curr_node, cfg::CFGNode::Exit);
          curr_node = curr_node->getNext()) {
         if (ISNODE(curr_node, cfg::CFGNode::ISPCBlockExit)) {
-            if (CASTAS(cfg::ConditionalNode *, curr_node->getNext())) {
-                curr_node = CASTAS(cfg::ConditionalNode *, curr_node->getNext())
-                                ->getReconv();
+            auto next = curr_node->getNext();
+            if (auto cond_node = llvm::dyn_cast<cfg::ConditionalNode>(next)) {
+                curr_node = cond_node->getReconv();
             } else if (ISNODE(curr_node->getNext(), cfg::CFGNode::ISPCBlock)) {
                 continue;
             }
-            curr_node = curr_node->splitEdge(new cfg::ISPCBlockNode());
+            curr_node =
+                curr_node->splitEdge(arena.create<cfg::ISPCBlockNode>());
         }
     }
     curr_node = curr_node->getPrevious();
-    curr_node = curr_node->splitEdge(new cfg::ISPCBlockExitNode());
-    curr_node->splitEdge(new cfg::ISPCGridExitNode());
+    curr_node =
+        curr_node->splitEdge(arena.create<cfg::ISPCBlockExitNode>());
+    curr_node->splitEdge(arena.create<cfg::ISPCGridExitNode>());
     return false;
 }
 
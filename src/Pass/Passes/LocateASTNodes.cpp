@@ -7,8 +7,6 @@ namespace pass {
 #define CFGNODE_DEF_VISITOR(NODE, NAME)                                        \
     auto LocateASTNodes::Visit##NODE##Node(cfg::NODE##Node *NAME)->bool
 
-#define CASTAS(TYPE, NODE) dynamic_cast<TYPE>(NODE)
-
 bool locateASTNodes(SpmdTUTy &spmd_tu, clang::ASTContext &ast_context,
                     Workspace &workspace) {
     LocateASTNodes finder(spmd_tu, ast_context, workspace);
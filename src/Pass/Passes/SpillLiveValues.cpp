@@ -0,0 +1,302 @@
+#include <spmdfy/Pass/Passes/SpillLiveValues.hpp>
+
+namespace spmdfy {
+
+namespace pass {
+
+using VarSetTy = std::set<const clang::VarDecl *>;
+
+bool isSpillableVar(const clang::VarDecl *var_decl) {
+    clang::QualType type = var_decl->getType();
+    return var_decl->isLocalVarDecl() && !var_decl->isStaticLocal() &&
+           !var_decl->hasAttr<clang::CUDASharedAttr>() &&
+           (type->isIntegerType() || type->isRealFloatingType() ||
+            type->isBooleanType());
+}
+
+/**
+ * Splits the kernel into the block regions between the ISPCBlock and
+ * ISPCBlockExit nodes and runs a backward liveness analysis over the regions
+ * of the variables declared at the top level of a region, which includes the
+ * regions of a loop or if body split by a barrier. Only the assignments
+ * outside of any control flow kill a variable, so a region skipped by an if
+ * or a loop never hides a use behind it. A declaration always kills, the
+ * variable is out of scope on every path which skips it.
+ * */
+class LiveAcrossBarriers {
+  public:
+    LiveAcrossBarriers(Workspace &workspace) : m_workspace(workspace) {}
+
+    auto run(cfg::KernelFuncNode *kernel) -> void {
+        walk(kernel->getNext());
+        computeLiveness();
+        auto &spilled = m_workspace.spilled_vars[kernel->getName()];
+        VarSetTy spilled_set;
+        for (auto &region : m_regions) {
+            for (auto var_decl : m_tracked) {
+                // a region passing the value through keeps it in the buffer
+                if (region.live_in.count(var_decl) &&
+                    region.referenced.count(var_decl)) {
+                    m_workspace.spill_loads[region.start].push_back(var_decl);
+                    spilled_set.insert(var_decl);
+                } else if (region.referenced.count(var_decl) &&
+                           !region.declared.count(var_decl)) {
+                    m_workspace.redeclared_vars[region.start].push_back(
+                        var_decl);
+                }
+                if (region.exit && region.live_out.count(var_decl) &&
+                    region.may_def.count(var_decl)) {
+                    m_workspace.spill_stores[region.exit].push_back(var_decl);
+                    spilled_set.insert(var_decl);
+                }
+            }
+        }
+        for (auto var_decl : m_tracked) {
+            if (spilled_set.count(var_decl)) {
+                SPMDFY_INFO("[SpillLiveValues] {} is live across a barrier",
+                            var_decl->getNameAsString());
+                spilled.push_back(var_decl);
+            }
+        }
+    }
+
+  private:
+    struct Region {
+        cfg::CFGNode *start = nullptr;
+        cfg::CFGNode *exit = nullptr;
+        /// number of ifs and loops around the region
+        int nesting = 0;
+        /// variables read before they are killed in the region
+        VarSetTy use;
+        /// variables declared or assigned outside of any control flow
+        VarSetTy def;
+        /// variables which may be written in the region
+        VarSetTy may_def;
+        VarSetTy referenced;
+        VarSetTy declared;
+        std::vector<size_t> succs;
+        VarSetTy live_in;
+        VarSetTy live_out;
+    };
+
+    auto getVarDecl(const clang::Expr *expr) -> const clang::VarDecl * {
+        if (auto decl_ref =
+                llvm::dyn_cast<clang::DeclRefExpr>(expr->IgnoreParens())) {
+            auto var_decl = llvm::dyn_cast<clang::VarDecl>(decl_ref->getDecl());
+            if (var_decl && m_tracked_set.count(var_decl)) {
+                return var_decl;
+            }
+        }
+        return nullptr;
+    }
+
+    auto handleRef(const clang::VarDecl *var_decl, bool read, bool write)
+        -> void {
+        if (m_curr < 0) {
+            return;
+        }
+        auto &region = m_regions[m_curr];
+        region.referenced.insert(var_decl);
+        if (read && !region.def.count(var_decl)) {
+            region.use.insert(var_decl);
+        }
+        if (write) {
+            region.may_def.insert(var_decl);
+        }
+    }
+
+    auto handleStmt(const clang::Stmt *stmt) -> void {
+        if (stmt == nullptr) {
+            return;
+        }
+        if (auto cast = llvm::dyn_cast<clang::ImplicitCastExpr>(stmt);
+            cast && cast->getCastKind() == clang::CK_LValueToRValue) {
+            if (auto var_decl = getVarDecl(cast->getSubExpr())) {
+                handleRef(var_decl, true, false);
+                return;
+            }
+        }
+        // any other reference may write through ++, -- or its address
+        if (auto decl_ref = llvm::dyn_cast<clang::DeclRefExpr>(stmt)) {
+            if (auto var_decl = getVarDecl(decl_ref)) {
+                handleRef(var_decl, true, true);
+            }
+            return;
+        }
+        if (auto binop = llvm::dyn_cast<clang::BinaryOperator>(stmt);
+            binop && binop->getOpcode() == clang::BO_Assign) {
+            if (auto var_decl = getVarDecl(binop->getLHS())) {
+                handleStmt(binop->getRHS());
+                handleRef(var_decl, false, true);
+                return;
+            }
+        }
+        if (auto decl_stmt = llvm::dyn_cast<clang::DeclStmt>(stmt)) {
+            for (auto decl : decl_stmt->decls()) {
+                if (auto var_decl = llvm::dyn_cast<clang::VarDecl>(decl)) {
+                    handleStmt(var_decl->getInit());
+                }
+            }
+            return;
+        }
+        for (auto child : stmt->children()) {
+            handleStmt(child);
+        }
+    }
+
+    auto kill(const clang::VarDecl *var_decl) -> void {
+        if (m_curr >= 0 && m_nesting == 0) {
+            m_regions[m_curr].def.insert(var_decl);
+        }
+    }
+
+    auto handleVarDecl(const clang::VarDecl *var_decl) -> void {
+        handleStmt(var_decl->getInit());
+        // a variable declared in control flow inside the region is scoped
+        // to the region
+        if (m_curr < 0 || m_nesting != m_regions[m_curr].nesting ||
+            !isSpillableVar(var_decl)) {
+            return;
+        }
+        m_tracked.push_back(var_decl);
+        m_tracked_set.insert(var_decl);
+        m_regions[m_curr].declared.insert(var_decl);
+        handleRef(var_decl, false, true);
+        m_regions[m_curr].def.insert(var_decl);
+    }
+
+    /// an assignment is only a kill when it is the whole statement
+    auto handleTopLevel(const clang::Stmt *stmt) -> void {
+        auto binop = llvm::dyn_cast<clang::BinaryOperator>(stmt);
+        if (binop && binop->getOpcode() == clang::BO_Assign) {
+            if (auto var_decl = getVarDecl(binop->getLHS())) {
+                handleStmt(binop->getRHS());
+                handleRef(var_decl, false, true);
+                kill(var_decl);
+                return;
+            }
+        }
+        handleStmt(stmt);
+    }
+
+    auto handleInternal(cfg::InternalNode *internal) -> void {
+        std::visit(
+            Overload{[&](const clang::Decl *decl) {
+                         if (auto var_decl =
+                                 llvm::dyn_cast<clang::VarDecl>(decl)) {
+                             handleVarDecl(var_decl);
+                         }
+                     },
+                     [&](const clang::Stmt *stmt) { handleTopLevel(stmt); },
+                     [&](const clang::Expr *expr) { handleStmt(expr); },
+                     [](const clang::Type *) {}},
+            internal->getInternalNode());
+    }
+
+    auto walk(cfg::CFGNode *node) -> void {
+        for (auto curr_node = node; !ISNODE(curr_node, cfg::CFGNode::Reconv) &&
+                                    !ISNODE(curr_node, cfg::CFGNode::Exit);
+             curr_node = curr_node->getNext()) {
+            switch (curr_node->getNodeType()) {
+            case cfg::CFGNode::ISPCBlock:
+                m_curr = m_regions.size();
+                m_regions.emplace_back();
+                m_regions.back().start = curr_node;
+                m_regions.back().nesting = m_nesting;
+                break;
+            case cfg::CFGNode::ISPCBlockExit:
+                if (m_curr >= 0) {
+                    m_regions[m_curr].exit = curr_node;
+                }
+                m_curr = -1;
+                break;
+            case cfg::CFGNode::Internal:
+                handleInternal(llvm::cast<cfg::InternalNode>(curr_node));
+                break;
+            case cfg::CFGNode::IfStmt: {
+                auto if_node = llvm::cast<cfg::IfStmtNode>(curr_node);
+                handleStmt(if_node->getIfStmt()->getCond());
+                m_nesting++;
+                walk(if_node->getTrueBlock());
+                walk(if_node->getFalseBlock());
+                m_nesting--;
+                curr_node = if_node->getReconv();
+                break;
+            }
+            case cfg::CFGNode::ForStmt: {
+                auto for_node = llvm::cast<cfg::ForStmtNode>(curr_node);
+                auto for_stmt = for_node->getForStmt();
+                handleStmt(for_stmt->getInit());
+                handleStmt(for_stmt->getCond());
+                handleStmt(for_stmt->getInc());
+                m_nesting++;
+                size_t first_region = m_regions.size();
+                walk(for_node->getNext());
+                // the regions of the loop body run again after the last one
+                if (m_regions.size() > first_region) {
+                    m_regions.back().succs.push_back(first_region);
+                }
+                m_nesting--;
+                curr_node = for_node->getReconv();
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+
+    auto computeLiveness() -> void {
+        for (size_t i = 0; i + 1 < m_regions.size(); i++) {
+            m_regions[i].succs.push_back(i + 1);
+        }
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t i = m_regions.size(); i-- > 0;) {
+                auto &region = m_regions[i];
+                VarSetTy live_out;
+                for (auto succ : region.succs) {
+                    live_out.insert(m_regions[succ].live_in.begin(),
+                                    m_regions[succ].live_in.end());
+                }
+                VarSetTy live_in = region.use;
+                for (auto var_decl : live_out) {
+                    if (!region.def.count(var_decl)) {
+                        live_in.insert(var_decl);
+                    }
+                }
+                if (live_in != region.live_in || live_out != region.live_out) {
+                    region.live_in = std::move(live_in);
+                    region.live_out = std::move(live_out);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    Workspace &m_workspace;
+    std::vector<Region> m_regions;
+    /// spillable kernel scope variables in the order of declaration
+    std::vector<const clang::VarDecl *> m_tracked;
+    VarSetTy m_tracked_set;
+    int m_curr = -1;
+    int m_nesting = 0;
+};
+
+bool spillLiveValues(SpmdTUTy &spmd_tu, clang::ASTContext &ast_context,
+                     Workspace &workspace) {
+    for (auto node : spmd_tu) {
+        if (ISNODE(node, cfg::CFGNode::KernelFunc)) {
+            SPMDFY_INFO("[SpillLiveValues] Visiting Kernel Func {}",
+                        node->getName());
+            LiveAcrossBarriers liveness(workspace);
+            liveness.run(llvm::cast<cfg::KernelFuncNode>(node));
+        }
+    }
+    return false;
+}
+
+} // namespace pass
+
+} // namespace spmdfy
@@ -6,7 +6,8 @@ auto SpmdfyAction::CreateASTConsumer(clang::CompilerInstance &Compiler,
                                      llvm::StringRef InFile)
     -> std::unique_ptr<clang::ASTConsumer> {
     return std::unique_ptr<clang::ASTConsumer>(
-        new SpmdfyConsumer(&Compiler.getASTContext(), m_file_writer));
+        new SpmdfyConsumer(&Compiler.getASTContext(), m_file_writer,
+                           m_host_writer));
 }
 
 auto SpmdfyConsumer::HandleTranslationUnit(clang::ASTContext &m_context)
@@ -14,6 +15,13 @@ auto SpmdfyConsumer::HandleTranslationUnit(clang::ASTContext &m_context)
     if (gen->handleTranslationUnit(m_context)) {
         SPMDFY_ERROR("Cannot Parse Translation Unit");
     }
+    if (host_gen && host_gen->handleTranslationUnit(m_context)) {
+        SPMDFY_ERROR("Cannot Rewrite the Host Code");
+        // fails the run, so the partially rewritten host code is removed
+        auto &diags = m_context.getDiagnostics();
+        diags.Report(diags.getCustomDiagID(clang::DiagnosticsEngine::Error,
+                                           "cannot rewrite the host code"));
+    }
 }
 
 auto SpmdfyFrontendActionFactory::create() -> clang::FrontendAction * {
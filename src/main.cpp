@@ -2,27 +2,311 @@
 #include <clang/Tooling/CommonOptionsParser.h>
 #include <clang/Tooling/Tooling.h>
 
+// llvm headers
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/raw_ostream.h>
+
 // spmdfy headers
 #include <spmdfy/CommandLineOpts.hpp>
+#include <spmdfy/FileCache.hpp>
 #include <spmdfy/Format.hpp>
 #include <spmdfy/Logger.hpp>
+#include <spmdfy/OutputCache.hpp>
+#include <spmdfy/PCHCache.hpp>
 #include <spmdfy/SpmdfyAction.hpp>
 
 // standard header
+#include <algorithm>
+#include <atomic>
 #include <fstream>
-#include <sstream>
+#include <map>
+#include <set>
 
 namespace spmdfy {
 extern std::string ispc_macros;
 }
 
+/// \return the arguments spmdfy adds to every compile command to parse the
+/// sources as CUDA host code
+static clang::tooling::ArgumentsAdjuster getCUDAArgumentsAdjuster() {
+    using namespace clang::tooling;
+    ArgumentsAdjuster adjuster = getInsertArgumentAdjuster(
+        {"-std=c++17", "-isystem", "./include/cuda_wrappers", "-isystem",
+         "./include", "--cuda-host-only", "-x", "cuda"},
+        ArgumentInsertPosition::BEGIN);
+    adjuster = combineAdjusters(adjuster, getClangSyntaxOnlyAdjuster());
+    if (verbosity) {
+        adjuster = combineAdjusters(
+            adjuster,
+            getInsertArgumentAdjuster("-v", ArgumentInsertPosition::END));
+    }
+    return adjuster;
+}
+
+/// \return the output opened for writing or nullptr after reporting the error
+static std::unique_ptr<llvm::raw_fd_ostream>
+openOutput(const std::string &output) {
+    std::error_code error_code;
+    auto out_file = llvm::make_unique<llvm::raw_fd_ostream>(
+        output, error_code, llvm::sys::fs::F_Text);
+    if (error_code) {
+        llvm::errs() << "[SPMDFY] error: " << error_code.message() << ": "
+                     << output << "\n";
+        return nullptr;
+    }
+    return out_file;
+}
+
+/// closes the output and removes it after reporting a write error
+/// \return returns true on failure
+static bool closeOutput(llvm::raw_fd_ostream &out_file,
+                        const std::string &output) {
+    out_file.close();
+    if (out_file.has_error()) {
+        llvm::errs() << "[SPMDFY] error: " << out_file.error().message()
+                     << ": " << output << "\n";
+        out_file.clear_error();
+        llvm::sys::fs::remove(output);
+        return true;
+    }
+    return false;
+}
+
+/// spmdfies a single source and writes it to output if it is not empty, and
+/// the rewritten host code to host_output if it is not empty. The output is
+/// reused from the cache when the hash of the preprocessed source and
+/// options_key is found in it
+/// \return returns true on failure
+static bool spmdfyFile(const clang::tooling::CompilationDatabase &compilations,
+                       const std::string &src, const std::string &output,
+                       const std::string &host_output,
+                       const std::string &depfile_name,
+                       const std::string &options_key,
+                       spmdfy::FileCache &file_cache,
+                       spmdfy::PCHCache *pch_cache) {
+    using namespace clang::tooling;
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> file_system(
+        new spmdfy::CachedFileSystem(file_cache));
+    ClangTool tool(compilations, {src},
+                   std::make_shared<clang::PCHContainerOperations>(),
+                   file_system);
+
+    std::error_code error_code;
+    std::string source_abs_path = spmdfy::getAbsoluteFilePath(src, error_code);
+    std::string includes =
+        "-I" + llvm::sys::path::parent_path(source_abs_path).str();
+
+    tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(
+        includes.c_str(), ArgumentInsertPosition::BEGIN));
+    tool.appendArgumentsAdjuster(getCUDAArgumentsAdjuster());
+
+    bool use_cache = !cache_dir.empty() && output != "" && host_output == "";
+    llvm::SmallString<32> cache_key;
+    if (use_cache || !depfile_name.empty()) {
+        llvm::MD5 hash;
+        std::vector<std::string> dependencies;
+        hash.update(options_key);
+        for (const auto &command : compilations.getCompileCommands(src)) {
+            for (const auto &arg : command.CommandLine) {
+                hash.update(arg);
+            }
+        }
+        spmdfy::HashPreprocessedActionFactory hash_action(hash, dependencies);
+        if (tool.run(&hash_action)) {
+            SPMDFY_ERROR("error: unable to preprocess file {}", src);
+            return true;
+        }
+        llvm::MD5::MD5Result hash_result;
+        hash.final(hash_result);
+        cache_key = hash_result.digest();
+
+        if (!depfile_name.empty() &&
+            spmdfy::cache::writeDepfile(depfile_name, output, dependencies)) {
+            return true;
+        }
+        if (use_cache && spmdfy::cache::lookup(cache_dir, cache_key, output)) {
+            return false;
+        }
+    }
+
+    // added after hashing as a preprocessor only action would include the
+    // source of the PCH instead of loading it
+    if (pch_cache) {
+        std::string pch = pch_cache->getPCH(
+            compilations, src, getCUDAArgumentsAdjuster(), file_system);
+        if (!pch.empty()) {
+            tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(
+                {"-include-pch", pch}, ArgumentInsertPosition::END));
+        }
+    }
+
+    // the generated code is streamed straight into the output when it is not
+    // formatted, otherwise it is formatted in memory before the single write
+    std::string code;
+    llvm::raw_string_ostream code_stream(code);
+    std::unique_ptr<llvm::raw_fd_ostream> out_file;
+    llvm::raw_ostream *out = &llvm::nulls();
+    if (output != "" && format_mode == FormatMode::None) {
+        if (!(out_file = openOutput(output))) {
+            return true;
+        }
+        out = out_file.get();
+    } else if (output != "") {
+        out = &code_stream;
+    }
+    if (!toggle_ispc_macros) {
+        *out << spmdfy::ispc_macros;
+    } else {
+        *out << "#include \"ISPCMacros.ispc.h\""
+             << "\n";
+    }
+
+    std::unique_ptr<llvm::raw_fd_ostream> host_file;
+    if (host_output != "" && !(host_file = openOutput(host_output))) {
+        return true;
+    }
+    llvm::raw_ostream *host_out = host_file.get();
+
+    // run SPMDfy action on the source
+    std::unique_ptr<spmdfy::format::IndentingOStream> indented;
+    if (format_mode == FormatMode::None) {
+        indented = llvm::make_unique<spmdfy::format::IndentingOStream>(*out);
+    }
+    spmdfy::SpmdfyFrontendActionFactory action(
+        indented ? static_cast<llvm::raw_ostream &>(*indented) : *out,
+        host_out);
+    bool failed = tool.run(&action);
+    indented.reset();
+    if (failed) {
+        SPMDFY_ERROR("error: unable to spmdfy file {}", src);
+        if (out_file) {
+            out_file.reset();
+            llvm::sys::fs::remove(output);
+        }
+        if (host_file) {
+            host_file.reset();
+            llvm::sys::fs::remove(host_output);
+        }
+        return true;
+    }
+
+    if (host_file) {
+        SPMDFY_INFO("Writing host code to : {}", host_output);
+        if (closeOutput(*host_file, host_output)) {
+            return true;
+        }
+    }
+
+    if (output != "") {
+        SPMDFY_INFO("Writing to : {}", output);
+        if (!out_file) {
+            code_stream.flush();
+            if (spmdfy::format::format(output, code, format_mode))
+                SPMDFY_ERROR("Unable to format");
+            if (!(out_file = openOutput(output))) {
+                return true;
+            }
+            *out_file << code;
+        }
+        if (closeOutput(*out_file, output)) {
+            return true;
+        }
+        if (use_cache) {
+            spmdfy::cache::store(cache_dir, cache_key, output);
+        }
+    }
+    return false;
+}
+
+/// \return the stamp of the spmdfy executable and the options which change
+/// the generated code, the output cache is keyed by them along with the source
+static std::string getOptionsKey(int argc, const char **argv,
+                                 const std::vector<std::string> &sources) {
+    std::string options_key;
+    std::string executable = llvm::sys::fs::getMainExecutable(
+        argv[0], reinterpret_cast<void *>(&getOptionsKey));
+    llvm::sys::fs::file_status executable_status;
+    if (!llvm::sys::fs::status(executable, executable_status)) {
+        options_key +=
+            std::to_string(executable_status.getSize()) + ":" +
+            std::to_string(llvm::sys::toTimeT(
+                executable_status.getLastModificationTime())) +
+            "\n";
+    }
+
+    // options naming the outputs or controlling the driver only
+    const std::set<llvm::StringRef> with_value = {
+        "o", "j", "MF", "cache-dir", "pch-cache", "host-output"};
+    const std::set<llvm::StringRef> without_value = {"MD", "v"};
+    for (int i = 1; i < argc; i++) {
+        llvm::StringRef arg(argv[i]);
+        if (std::find(sources.begin(), sources.end(), arg) != sources.end()) {
+            continue;
+        }
+        llvm::StringRef name = arg.ltrim('-').split('=').first;
+        if (arg.startswith("-") && with_value.count(name)) {
+            i += !arg.contains('=');
+            continue;
+        }
+        if (arg.startswith("-") && without_value.count(name)) {
+            continue;
+        }
+        options_key += arg.str() + "\n";
+    }
+    return options_key;
+}
+
+/// \return output path of a source when multiple sources are spmdfied, -o
+/// names the output directory
+static std::string getOutputFilename(const std::string &src) {
+    llvm::SmallString<256> output(output_filename.empty() ? "."
+                                                          : output_filename);
+    llvm::sys::path::append(output, llvm::sys::path::stem(src) + ".ispc");
+    return output.str();
+}
+
+/// \return host output path of a source when multiple sources are spmdfied,
+/// --host-output names the output directory
+static std::string getHostOutputFilename(const std::string &src) {
+    if (host_output.empty()) {
+        return "";
+    }
+    llvm::SmallString<256> output(host_output.getValue());
+    llvm::sys::path::append(output, llvm::sys::path::stem(src) + ".cpp");
+    return output.str();
+}
+
+/// \return true after reporting the sources which get_output maps to the same
+/// output, the stem of the source is not unique across directories
+static bool
+hasOutputCollision(const std::vector<std::string> &file_sources,
+                   std::string (*get_output)(const std::string &)) {
+    std::map<std::string, std::string> outputs;
+    bool collision = false;
+    for (const auto &src : file_sources) {
+        std::string output = get_output(src);
+        if (output.empty()) {
+            continue;
+        }
+        auto inserted = outputs.emplace(output, src);
+        if (!inserted.second) {
+            llvm::errs() << "[SPMDFY] error: " << inserted.first->second
+                         << " and " << src << " are both written to "
+                         << output << "\n";
+            collision = true;
+        }
+    }
+    return collision;
+}
+
 int main(int argc, const char **argv) {
     spmdfy::Logger::initLogger();
     using namespace clang::tooling;
     CommonOptionsParser options_parser(argc, argv, spmdfy_options,
                                        llvm::cl::Optional);
-    ClangTool tool(options_parser.getCompilations(),
-                   options_parser.getSourcePathList());
     std::vector<std::string> file_sources = options_parser.getSourcePathList();
 
     if (generate_ispc_macros != std::string()) {
@@ -38,59 +322,59 @@ int main(int argc, const char **argv) {
         return 1;
     }
 
-    std::error_code error_code;
-
-    std::string &src = file_sources[0];
-    std::string source_abs_path = spmdfy::getAbsoluteFilePath(src, error_code);
-    std::string includes =
-        "-I" + llvm::sys::path::parent_path(source_abs_path).str();
-
-    tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(
-        includes.c_str(), ArgumentInsertPosition::BEGIN));
-    tool.appendArgumentsAdjuster(
-        getInsertArgumentAdjuster("cuda", ArgumentInsertPosition::BEGIN));
-    tool.appendArgumentsAdjuster(
-        getInsertArgumentAdjuster("-x", ArgumentInsertPosition::BEGIN));
-    tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(
-        "--cuda-host-only", ArgumentInsertPosition::BEGIN));
-    tool.appendArgumentsAdjuster(
-        getInsertArgumentAdjuster("./include", ArgumentInsertPosition::BEGIN));
-    tool.appendArgumentsAdjuster(
-        getInsertArgumentAdjuster("-isystem", ArgumentInsertPosition::BEGIN));
-    tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(
-        "./include/cuda_wrappers", ArgumentInsertPosition::BEGIN));
-    tool.appendArgumentsAdjuster(
-        getInsertArgumentAdjuster("-isystem", ArgumentInsertPosition::BEGIN));
-    tool.appendArgumentsAdjuster(
-        getInsertArgumentAdjuster("-std=c++17", ArgumentInsertPosition::BEGIN));
-    tool.appendArgumentsAdjuster(getClangSyntaxOnlyAdjuster());
-    if (verbosity) {
-        tool.appendArgumentsAdjuster(
-            getInsertArgumentAdjuster("-v", ArgumentInsertPosition::END));
+    if (block_dim.size() > 3 ||
+        std::find(block_dim.begin(), block_dim.end(), 0u) != block_dim.end()) {
+        llvm::errs() << "[SPMDFY] error: --block-dim takes up to 3 non zero "
+                        "dimensions\n";
+        return 1;
     }
 
-    std::ostringstream tu_stream;
+    std::string options_key = getOptionsKey(argc, argv, file_sources);
+    spmdfy::FileCache file_cache;
+    std::unique_ptr<spmdfy::PCHCache> pch_cache;
+    if (!pch_cache_dir.empty()) {
+        pch_cache =
+            llvm::make_unique<spmdfy::PCHCache>(pch_cache_dir, options_key);
+    }
+    if (file_sources.size() == 1) {
+        std::string depfile_name = depfile;
+        if (depfile_name.empty() && generate_depfile && output_filename != "") {
+            depfile_name = output_filename + ".d";
+        }
+        return spmdfyFile(options_parser.getCompilations(), file_sources[0],
+                          output_filename, host_output, depfile_name,
+                          options_key, file_cache, pch_cache.get());
+    }
 
-    // run SPMDfy action on the source
-    spmdfy::SpmdfyFrontendActionFactory action(tu_stream);
-    if (tool.run(&action)) {
-        SPMDFY_ERROR("error: unable to spmdfy file");
+    if (hasOutputCollision(file_sources, getOutputFilename) ||
+        hasOutputCollision(file_sources, getHostOutputFilename)) {
         return 1;
     }
-
-    if (output_filename != "") {
-        SPMDFY_INFO("Writing to : {}", output_filename);
-        std::fstream out_file(output_filename, std::ios_base::out);
-        if (!toggle_ispc_macros) {
-            out_file << spmdfy::ispc_macros;
-        } else {
-            out_file << "#include \"ISPCMacros.ispc.h\""
-                     << "\n";
+    for (const std::string &output_dir :
+         {output_filename.getValue(), host_output.getValue()}) {
+        if (output_dir.empty()) {
+            continue;
+        }
+        if (auto error_code = llvm::sys::fs::create_directories(output_dir)) {
+            llvm::errs() << "[SPMDFY] error: " << error_code.message() << ": "
+                         << output_dir << "\n";
+            return 1;
         }
-        out_file << tu_stream.str();
-        out_file.close();
-        if (spmdfy::format::format(output_filename))
-            SPMDFY_ERROR("Unable to format");
     }
-    return 0;
-}
\ No newline at end of file
+
+    std::atomic<bool> failed(false);
+    llvm::ThreadPool pool(jobs ? unsigned(jobs) : llvm::hardware_concurrency());
+    for (const auto &src : file_sources) {
+        pool.async([&, src] {
+            std::string output = getOutputFilename(src);
+            if (spmdfyFile(options_parser.getCompilations(), src, output,
+                           getHostOutputFilename(src),
+                           generate_depfile ? output + ".d" : "", options_key,
+                           file_cache, pch_cache.get())) {
+                failed = true;
+            }
+        });
+    }
+    pool.wait();
+    return failed;
+}
@@ -2,10 +2,14 @@
 #include <spmdfy/Logger.hpp>
 
 namespace spmdfy {
-std::string sourceDump(const clang::SourceManager &sm,
-                       const clang::LangOptions &lang_opt,
-                       const clang::SourceLocation &begin,
-                       const clang::SourceLocation &end) {
+
+static thread_local SourceSlicer *active_slicer = nullptr;
+
+/// resolves the char range through the Lexer, uncached
+static llvm::StringRef lexSlice(const clang::SourceManager &sm,
+                                const clang::LangOptions &lang_opt,
+                                const clang::SourceLocation &begin,
+                                const clang::SourceLocation &end) {
     clang::SourceLocation e(
         clang::Lexer::getLocForEndOfToken(end, 0, sm, lang_opt));
     clang::SourceLocation b(
@@ -14,8 +18,53 @@ std::string sourceDump(const clang::SourceManager &sm,
         SPMDFY_ERROR("SRCDUMP: Canont dump source");
         return "";
     }
-    return std::string(sm.getCharacterData(begin),
-                       (sm.getCharacterData(e) - sm.getCharacterData(b)));
+    return llvm::StringRef(sm.getCharacterData(begin),
+                           (sm.getCharacterData(e) - sm.getCharacterData(b)));
+}
+
+SourceSlicer::SourceSlicer(const clang::SourceManager &sm,
+                           const clang::LangOptions &lang_opts)
+    : m_sm(sm), m_lang_opts(lang_opts), m_enclosing(active_slicer) {
+    active_slicer = this;
+}
+
+SourceSlicer::~SourceSlicer() { active_slicer = m_enclosing; }
+
+auto SourceSlicer::slice(clang::SourceLocation begin,
+                         clang::SourceLocation end) -> llvm::StringRef {
+    auto key = std::make_pair(begin.getRawEncoding(), end.getRawEncoding());
+    auto cached = m_slices.find(key);
+    if (cached != m_slices.end()) {
+        return cached->second;
+    }
+    return m_slices[key] = lexSlice(m_sm, m_lang_opts, begin, end);
+}
+
+auto SourceSlicer::getActive(const clang::SourceManager &sm)
+    -> SourceSlicer * {
+    for (auto slicer = active_slicer; slicer; slicer = slicer->m_enclosing) {
+        if (&slicer->m_sm == &sm) {
+            return slicer;
+        }
+    }
+    return nullptr;
+}
+
+llvm::StringRef sourceSlice(const clang::SourceManager &sm,
+                            const clang::LangOptions &lang_opt,
+                            const clang::SourceLocation &begin,
+                            const clang::SourceLocation &end) {
+    if (auto slicer = SourceSlicer::getActive(sm)) {
+        return slicer->slice(begin, end);
+    }
+    return lexSlice(sm, lang_opt, begin, end);
+}
+
+std::string sourceDump(const clang::SourceManager &sm,
+                       const clang::LangOptions &lang_opt,
+                       const clang::SourceLocation &begin,
+                       const clang::SourceLocation &end) {
+    return sourceSlice(sm, lang_opt, begin, end).str();
 }
 
 std::string getFileNameFromSource(std::string filepath) {